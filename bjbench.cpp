@@ -0,0 +1,526 @@
+/***************************************************************************
+* File: bjbench.cpp
+* Author: Milan Gulati
+* Procedures:
+* main          - runs the benchmarks, compares them to a baseline and saves one
+* operator new  - counts heap allocations for the allocs/op column
+* shuffleShoe   - Fisher-Yates over a multi-deck shoe, for the shoe benchmark
+* buildCorpus   - collects the hands handValue sees in real games
+* benchRun      - times one benchmark and returns ns/op and allocs/op
+* loadBaseline  - reads a baseline file written with -w
+* saveBaseline  - writes the results as a baseline file
+***************************************************************************/
+
+/* Import Libraries */
+#include <unistd.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <bits/stdc++.h>
+#include <iomanip>
+#include <iostream>
+#include "blackjack_stats.h"
+#include "blackjack_deck.h"
+#include "blackjack_shuffle.h"
+#include "blackjack_game.h"
+#include "blackjack_dealercache.h"
+
+using namespace std;
+
+#define BENCH_REPS      5                   // repetitions, the median is reported
+#define BENCH_SHOE      6                   // decks in the multi-deck shoe benchmark
+#define BENCH_DECKS     1024                // pre-shuffled decks cycled through (power of two)
+#define BENCH_HANDS     16384               // hands in the handValue corpus (power of two)
+#define BENCH_SEED      1                   // fixed seed, every run measures the same work
+
+// one benchmark: runs iters operations and returns a checksum so the
+// compiler cannot drop the work
+struct benchCase
+{
+    const char *name;                       // name in the report and the baseline file
+    const char *what;                       // what one operation is
+    long (*run)(long iters);
+};
+
+// one measurement, or one baseline line
+struct benchResult
+{
+    double nsPerOp;                         // median over BENCH_REPS repetitions
+    double allocsPerOp;                     // heap allocations per operation
+};
+
+/* Function Prototypes */
+void shuffleShoe(char shoe[], unsigned long seed, long game);          // multi-deck shuffle
+void buildCorpus();                                                     // realistic hands for handValue
+benchResult benchRun(const benchCase &bench, double minTime);           // time one benchmark
+bool loadBaseline(const char *path, map<string, benchResult> &base);    // read a baseline file
+bool saveBaseline(const char *path, const vector<string> &names, const vector<benchResult> &results);
+
+long allocCount = 0;                        // operator new calls so far
+volatile long sink;                         // benchmark checksums end up here
+
+vector<vector<char>> corpus;                // hands as handValue sees them during play
+vector<int> corpusValues;                   // handValue of each corpus hand
+char decks[BENCH_DECKS][DECK_SIZE];         // decks dealt for games 0..BENCH_DECKS-1
+dealerCache oddsCache = {{}, {}, 0, 0, 0, handValue, dealer, {}, {}};
+ruleTables plainRules;                      // the hit/stand game the variants play by default
+ruleTables allRules;                        // --rules all
+
+/***************************************************************************
+* void *operator new(size_t size)
+* Author: Milan Gulati
+* Description: Replaces the global allocator so every heap allocation made
+*              by a benchmark is counted. new[] and the STL containers all
+*              come through here; delete is replaced to match.
+*
+* Parameters:
+*   size        I/P     size_t      Bytes requested
+*   operator new O/P    void *      Allocated memory
+***************************************************************************/
+void *operator new(size_t size)
+{
+    allocCount++;
+    void *p = malloc(size ? size : 1);
+    if(p == NULL)
+        throw bad_alloc();
+    return p;
+}
+
+void operator delete(void *p) noexcept
+{
+    free(p);
+}
+
+void operator delete(void *p, size_t) noexcept
+{
+    free(p);
+}
+
+/* Benchmarks */
+
+// handValue over the hands players and dealer hold during real games
+long benchHandValue(long iters)
+{
+    long sum = 0;
+    for(long i = 0; i < iters; i++)
+        sum += handValue(corpus[i & (BENCH_HANDS - 1)]);
+    return sum;
+}
+
+// every hit/stand decision made during real games
+long benchStrategy(long iters)
+{
+    long sum = 0;
+    for(long i = 0; i < iters; i++)
+    {
+        int val = corpusValues[i & (BENCH_HANDS - 1)];
+        sum += playerOne(val) + playerTwo(val) + dealer(val);
+    }
+    return sum;
+}
+
+// the deck of one game, as every variant deals it
+long benchShuffle(long iters)
+{
+    char cards[DECK_SIZE];
+    long sum = 0;
+    for(long i = 0; i < iters; i++)
+    {
+        shuffleDeck(cards, BENCH_SEED, i);
+        sum += cards[0];
+    }
+    return sum;
+}
+
+// the same decks dealt SHUFFLE_LANES games at a time through the ring
+long benchShuffleRing(long iters)
+{
+    static deckRing ring;
+    ringStart(ring, BENCH_SEED);
+    long sum = 0;
+    for(long i = 0; i < iters; i++)
+        sum += ringDeal(ring, i)[0];
+    return sum;
+}
+
+// a six deck shoe through the same generator
+long benchShuffleShoe(long iters)
+{
+    static char shoe[BENCH_SHOE * DECK_SIZE];
+    long sum = 0;
+    for(long i = 0; i < iters; i++)
+    {
+        shuffleShoe(shoe, BENCH_SEED, i);
+        sum += shoe[0];
+    }
+    return sum;
+}
+
+// the dealer's draw loop, from its two cards to standing, after the
+// players have taken their cards
+long benchDealerDraw(long iters)
+{
+    long sum = 0;
+    for(long i = 0; i < iters; i++)
+    {
+        const char *cards = decks[i & (BENCH_DECKS - 1)];
+        int spot = 6 + (int) (i & 7);       // players took somewhere around 0-7 hits
+        sum += dealerPlay(plainRules, cards, spot);
+    }
+    return sum;
+}
+
+// the exact dealer outcome behind --expected, with a warm memo table
+long benchDealerOdds(long iters)
+{
+    long sum = 0;
+    for(long i = 0; i < iters; i++)
+    {
+        const char *cards = decks[i & (BENCH_DECKS - 1)];
+        int unseen[RANKS];
+        shoeUnseen(cards, 6 + (int) (i & 7), unseen);
+        dealerOdds odds = dealerOutcome(oddsCache, unseen, cards[0]);
+        sum += (long) (odds.p[ODDS_BUST] * 1000);
+    }
+    return sum;
+}
+
+// one whole game in process: deal, both players, dealer, score
+long benchGame(long iters)
+{
+    static deckRing ring;                   // dealt like the variants' dealers do
+    ringStart(ring, BENCH_SEED);
+    long wins[3] = {0, 0, 0};
+    netTally net = {{0, 0}, {0, 0}};
+    for(long i = 0; i < iters; i++)
+        playGame(plainRules, ringDeal(ring, i), wins, net);
+    return wins[0] + wins[1] + wins[2];
+}
+
+// the same game with doubles, splits, surrender and h17, to keep the
+// extra rules' cost next to game_local
+long benchGameRules(long iters)
+{
+    static deckRing ring;
+    ringStart(ring, BENCH_SEED);
+    long wins[3] = {0, 0, 0};
+    netTally net = {{0, 0}, {0, 0}};
+    for(long i = 0; i < iters; i++)
+        playGame(allRules, ringDeal(ring, i), wins, net);
+    return wins[0] + wins[1] + wins[2] + net.halves[0];
+}
+
+static const benchCase benches[] = {
+    {"hand_value",      "handValue() of one hand",              benchHandValue},
+    {"strategy",        "three hit/stand decisions",            benchStrategy},
+    {"shuffle_deck",    "one 52 card deck",                     benchShuffle},
+    {"shuffle_ring",    "one 52 card deck, dealt in batches",   benchShuffleRing},
+    {"shuffle_shoe",    "one 6 deck shoe",                      benchShuffleShoe},
+    {"dealer_draw",     "dealer draws to 17 or bust",           benchDealerDraw},
+    {"dealer_odds",     "exact dealer outcome (memoized)",      benchDealerOdds},
+    {"game_local",      "one full game in process",             benchGame},
+    {"game_rules",      "one full game, --rules all",           benchGameRules},
+};
+static const int benchCount = sizeof(benches) / sizeof(benches[0]);
+
+/***************************************************************************
+* int main()
+* Author: Milan Gulati
+* Description: Microbenchmarks of the simulation kernels. Each benchmark is
+*              run for at least the minimum time, BENCH_REPS times, and the
+*              median ns/op is reported with the heap allocations per op.
+*              With -b the results are compared to a baseline file and any
+*              benchmark slower than the tolerance, or allocating more, is
+*              marked as a regression. -w saves the results as a baseline.
+*
+*              usage: bjbench [-b FILE] [-w FILE] [-t PCT] [-m MS] [-f NAME]
+*                -b   compare against the baseline in FILE
+*                -w   write the results to FILE as the new baseline
+*                -t   allowed slowdown in percent (default 10)
+*                -m   minimum milliseconds per repetition (default 200)
+*                -f   only run benchmarks whose name contains NAME
+*
+* Parameters:
+*   argc    I/P     int         Number of arguments on command line
+*   argv    I/P     char *[]    Arguments listed on command line
+*   main    O/P     int         0 if no regression, 2 on a regression, 1 on bad options or files
+***************************************************************************/
+int main(int argc, char *argv[])
+{
+    const char *baseline = NULL;            // baseline to compare with
+    const char *save = NULL;                // baseline to write
+    double tolerance = 10.0;                // allowed slowdown in percent
+    double minTime = 0.2;                   // seconds per repetition
+    const char *filter = NULL;              // substring of the benchmarks to run
+
+    int c;
+    while((c = getopt(argc, argv, "b:w:t:m:f:")) != -1)
+    {
+        switch(c)
+        {
+        case 'b':
+            baseline = optarg;
+            break;
+        case 'w':
+            save = optarg;
+            break;
+        case 't':
+            tolerance = atof(optarg);
+            break;
+        case 'm':
+            minTime = atof(optarg) / 1000.0;
+            break;
+        case 'f':
+            filter = optarg;
+            break;
+        default:
+            cerr << "usage: " << argv[0] << " [-b FILE] [-w FILE] [-t PCT] [-m MS] [-f NAME]" << endl;
+            return 1;
+        }
+    }
+    if(tolerance < 0 || minTime <= 0)
+    {
+        cerr << "usage: " << argv[0] << " [-b FILE] [-w FILE] [-t PCT] [-m MS] [-f NAME]" << endl;
+        return 1;
+    }
+
+    map<string, benchResult> base;
+    if(baseline != NULL && !loadBaseline(baseline, base))
+    {
+        cerr << "bjbench: cannot read baseline " << baseline << endl;
+        return 1;
+    }
+
+    /* Inputs */
+    // built once, outside the timed loops
+    buildCorpus();
+    rulesBuild(plainRules, 0);
+    rulesBuild(allRules, RULE_ALL);
+    for(long g = 0; g < BENCH_DECKS; g++)
+        shuffleDeck(decks[g], BENCH_SEED, g);
+
+    /* Run */
+    vector<string> names;
+    vector<benchResult> results;
+    int regressions = 0;
+
+    cout << left << setw(14) << "benchmark" << right << setw(12) << "ns/op" << setw(12) << "allocs/op";
+    if(baseline != NULL)
+        cout << setw(12) << "base ns/op" << setw(10) << "change";
+    cout << "   per op" << endl;
+    cout << fixed;
+    for(int b = 0; b < benchCount; b++)
+    {
+        if(filter != NULL && strstr(benches[b].name, filter) == NULL)
+            continue;
+        benchResult r = benchRun(benches[b], minTime);
+        names.push_back(benches[b].name);
+        results.push_back(r);
+
+        cout << left << setw(14) << benches[b].name << right
+             << setw(12) << setprecision(2) << r.nsPerOp
+             << setw(12) << setprecision(2) << r.allocsPerOp;
+        if(baseline != NULL)
+        {
+            auto it = base.find(benches[b].name);
+            if(it == base.end())
+                cout << setw(12) << "-" << setw(10) << "new";
+            else
+            {
+                double change = 100.0 * (r.nsPerOp - it->second.nsPerOp) / it->second.nsPerOp;
+                // allocation counts are exact, so any increase is a regression
+                bool slower = change > tolerance;
+                bool allocs = r.allocsPerOp > it->second.allocsPerOp + 0.005;
+                cout << setw(12) << setprecision(2) << it->second.nsPerOp
+                     << setw(9) << setprecision(1) << showpos << change << "%" << noshowpos;
+                if(slower || allocs)
+                {
+                    regressions++;
+                    cout << "   REGRESSION" << (allocs ? " (allocs)" : "");
+                }
+            }
+        }
+        cout << "   " << benches[b].what << endl;
+    }
+
+    if(save != NULL && !saveBaseline(save, names, results))
+    {
+        cerr << "bjbench: cannot write baseline " << save << endl;
+        return 1;
+    }
+    if(regressions > 0)
+    {
+        cout << regressions << " benchmark(s) regressed beyond " << setprecision(1) << tolerance << "%" << endl;
+        return 2;
+    }
+    return 0;
+}
+
+/***************************************************************************
+* void shuffleShoe(char shoe[], unsigned long seed, long game)
+* Author: Milan Gulati
+* Description: shuffleDeck for a shoe of BENCH_SHOE decks: the same
+*              per-game random stream and division free bounding, over
+*              BENCH_SHOE * DECK_SIZE cards.
+*
+* Parameters:
+*   shoe    O/P     char []         BENCH_SHOE * DECK_SIZE cards
+*   seed    I/P     unsigned long   Seed of the whole run
+*   game    I/P     long            Index of the game in the run
+***************************************************************************/
+void shuffleShoe(char shoe[], unsigned long seed, long game)
+{
+    for(int d = 0; d < BENCH_SHOE; d++)
+        memcpy(&shoe[d * DECK_SIZE], deckOrder, DECK_SIZE);
+    unsigned long state = gameState(seed, game);
+    for(int j = BENCH_SHOE * DECK_SIZE - 1; j > 0; j--)
+    {
+        unsigned int k = boundedRand(splitmix64(state), j + 1);
+        char temp = shoe[j];
+        shoe[j] = shoe[k];
+        shoe[k] = temp;
+    }
+}
+
+/***************************************************************************
+* void buildCorpus()
+* Author: Milan Gulati
+* Description: Plays games until BENCH_HANDS hands are collected, keeping
+*              every hand at the moment it is valued: two card hands, hands
+*              after each hit, soft and hard, in the mix real games produce.
+*
+* Parameters:
+*   (none)
+***************************************************************************/
+void buildCorpus()
+{
+    char cards[DECK_SIZE];
+    for(long g = 0; (long) corpus.size() < BENCH_HANDS; g++)
+    {
+        shuffleDeck(cards, BENCH_SEED, g);
+        int spot = 6;
+        for(int seat = 0; seat < 3; seat++)
+        {
+            vector<char> hand;
+            if(seat == 2)
+                hand.assign(cards, cards + 2);
+            else
+                hand.assign(cards + 2 + 2 * seat, cards + 4 + 2 * seat);
+            while(true)
+            {
+                corpus.push_back(hand);
+                int val = handValue(hand);
+                bool hit = seat == 0 ? playerOne(val) : seat == 1 ? playerTwo(val) : dealer(val);
+                if(!hit)
+                    break;
+                hand.push_back(cards[spot++]);
+            }
+        }
+    }
+    corpus.resize(BENCH_HANDS);
+    for(auto &hand: corpus)
+        corpusValues.push_back(handValue(hand));
+}
+
+/***************************************************************************
+* benchResult benchRun(const benchCase &bench, double minTime)
+* Author: Milan Gulati
+* Description: Doubles the iteration count until one run takes a tenth of
+*              minTime, scales it to minTime, then times BENCH_REPS runs of
+*              that many iterations. The median ns/op is kept, which shrugs
+*              off a run disturbed by the scheduler. Allocations are counted
+*              over the last run.
+*
+* Parameters:
+*   bench       I/P     const benchCase &   Benchmark to run
+*   minTime     I/P     double              Seconds each repetition should take
+*   benchRun    O/P     benchResult         ns/op and allocs/op
+***************************************************************************/
+benchResult benchRun(const benchCase &bench, double minTime)
+{
+    long iters = 1;
+    while(true)
+    {
+        double start = monotonicNow();
+        sink = bench.run(iters);
+        double took = monotonicNow() - start;
+        if(took >= minTime / 10)
+        {
+            iters = (long) (iters * minTime / took) + 1;
+            break;
+        }
+        iters *= 2;
+    }
+
+    double ns[BENCH_REPS];
+    long allocs = 0;
+    for(int r = 0; r < BENCH_REPS; r++)
+    {
+        long before = allocCount;
+        double start = monotonicNow();
+        sink = bench.run(iters);
+        ns[r] = (monotonicNow() - start) * 1e9 / iters;
+        allocs = allocCount - before;
+    }
+    sort(ns, ns + BENCH_REPS);
+
+    benchResult result;
+    result.nsPerOp = ns[BENCH_REPS / 2];
+    result.allocsPerOp = (double) allocs / iters;
+    return result;
+}
+
+/***************************************************************************
+* bool loadBaseline(const char *path, map<string, benchResult> &base)
+* Author: Milan Gulati
+* Description: Reads "name ns_per_op allocs_per_op" lines written by
+*              saveBaseline. Lines starting with '#' are comments.
+*
+* Parameters:
+*   path            I/P     const char *                    Baseline file
+*   base            O/P     map<string, benchResult> &      Results by benchmark name
+*   loadBaseline    O/P     bool                            False if the file cannot be read
+***************************************************************************/
+bool loadBaseline(const char *path, map<string, benchResult> &base)
+{
+    ifstream in(path);
+    if(!in)
+        return false;
+    string line;
+    while(getline(in, line))
+    {
+        if(line.empty() || line[0] == '#')
+            continue;
+        istringstream fields(line);
+        string name;
+        benchResult r;
+        if(fields >> name >> r.nsPerOp >> r.allocsPerOp)
+            base[name] = r;
+    }
+    return true;
+}
+
+/***************************************************************************
+* bool saveBaseline(const char *path, const vector<string> &names, const vector<benchResult> &results)
+* Author: Milan Gulati
+* Description: Writes one "name ns_per_op allocs_per_op" line per benchmark.
+*              Baselines are machine specific, so the host is noted in a
+*              comment line.
+*
+* Parameters:
+*   path            I/P     const char *                    Baseline file to write
+*   names           I/P     const vector<string> &          Benchmark names
+*   results         I/P     const vector<benchResult> &     Results in the same order
+*   saveBaseline    O/P     bool                            False if the file cannot be written
+***************************************************************************/
+bool saveBaseline(const char *path, const vector<string> &names, const vector<benchResult> &results)
+{
+    FILE *f = fopen(path, "w");
+    if(f == NULL)
+        return false;
+    char host[256] = "unknown";
+    gethostname(host, sizeof(host) - 1);
+    fprintf(f, "# bjbench baseline from %s: name ns_per_op allocs_per_op\n", host);
+    for(size_t i = 0; i < names.size(); i++)
+        fprintf(f, "%s %.3f %.3f\n", names[i].c_str(), results[i].nsPerOp, results[i].allocsPerOp);
+    return fclose(f) == 0;
+}
@@ -0,0 +1,215 @@
+/***************************************************************************
+* File: bjresults.cpp
+* Author: Milan Gulati
+* Procedures:
+* main          - maps a results file, filters its rows and prints them
+* parseFilter   - parses a COLUMN<op>VALUE filter
+* columnValue   - reads one value of a column as a double
+***************************************************************************/
+
+/* Import Libraries */
+#include <unistd.h>
+#include <stdlib.h>
+#include <bits/stdc++.h>
+#include <iomanip>
+#include <iostream>
+#include "blackjack_results.h"
+
+using namespace std;
+
+// one -w COLUMN<op>VALUE condition
+struct rowFilter
+{
+    int column;                             // column index in the file
+    char op;                                // '=', '!', '<' or '>'
+    double value;                           // compared as a double, exact for integer columns below 2^53
+};
+
+/* Function Prototypes */
+bool parseFilter(const resultsView &view, const char *text, rowFilter &f);  // COLUMN<op>VALUE
+double columnValue(const resultsView &view, int c, long r);                // one value as a double
+
+/***************************************************************************
+* int main()
+* Author: Milan Gulati
+* Description: Reader for the results files written with --results. The
+*              file is memory mapped, so opening it costs the same for ten
+*              rows or ten million; each -w condition is then evaluated over
+*              one column array at a time. Matching rows are printed as an
+*              aligned table or as CSV.
+*
+*              usage: bjresults [-c] [-n] [-w COLUMN<op>VALUE]... FILE
+*                -c   print CSV instead of a table
+*                -n   only print how many rows match
+*                -w   keep rows where COLUMN is =, !=, < or > VALUE
+*                     (repeatable, all must hold; variant also takes M, P or H)
+*
+* Parameters:
+*   argc    I/P     int         Number of arguments on command line
+*   argv    I/P     char *[]    Arguments listed on command line
+*   main    O/P     int         Status code returns 1 on bad options or an unreadable file
+***************************************************************************/
+int main(int argc, char *argv[])
+{
+    bool csv = false;                                   // CSV instead of a table
+    bool count = false;                                 // only count matching rows
+    vector<const char *> where;                         // -w conditions, parsed once the file is open
+
+    int c;
+    while((c = getopt(argc, argv, "cnw:")) != -1)
+    {
+        switch(c)
+        {
+        case 'c':
+            csv = true;
+            break;
+        case 'n':
+            count = true;
+            break;
+        case 'w':
+            where.push_back(optarg);
+            break;
+        default:
+            cerr << "usage: " << argv[0] << " [-c] [-n] [-w COLUMN<op>VALUE]... FILE" << endl;
+            return 1;
+        }
+    }
+    if(optind != argc - 1)
+    {
+        cerr << "usage: " << argv[0] << " [-c] [-n] [-w COLUMN<op>VALUE]... FILE" << endl;
+        return 1;
+    }
+
+    /* Map The File */
+    resultsView view;
+    if(!resultsOpen(argv[optind], view))
+    {
+        cerr << "bjresults: " << argv[optind] << " is missing or not a results file" << endl;
+        return 1;
+    }
+    const resultsHeader *h = view.header;
+    long rows = __atomic_load_n(&h->rows, __ATOMIC_ACQUIRE);    // rows published so far
+
+    /* Filter */
+    // column at a time over the mapped arrays; keep[r] survives every condition
+    vector<char> keep(rows, 1);
+    for(const char *text: where)
+    {
+        rowFilter f;
+        if(!parseFilter(view, text, f))
+        {
+            cerr << "bjresults: bad filter " << text << endl;
+            return 1;
+        }
+        for(long r = 0; r < rows; r++)
+        {
+            double v = columnValue(view, f.column, r);
+            bool pass = f.op == '=' ? v == f.value : f.op == '!' ? v != f.value
+                      : f.op == '<' ? v < f.value : v > f.value;
+            keep[r] &= pass;
+        }
+    }
+    long matched = count_if(keep.begin(), keep.end(), [](char k) { return k != 0; });
+    if(count)
+    {
+        cout << matched << " of " << rows << " rows" << endl;
+        return 0;
+    }
+
+    /* Print */
+    const char *sep = csv ? "," : "";
+    for(long col = 0; col < h->columns; col++)
+    {
+        if(csv)
+            cout << (col ? sep : "") << h->column[col].name;
+        else
+            cout << setw(16) << h->column[col].name;
+    }
+    cout << endl;
+    for(long r = 0; r < rows; r++)
+    {
+        if(!keep[r])
+            continue;
+        for(long col = 0; col < h->columns; col++)
+        {
+            ostringstream cell;
+            if(h->column[col].type == RESULTS_INT)
+            {
+                long v = resultsInts(view, col)[r];
+                if(strcmp(h->column[col].name, "variant") == 0 && v > ' ' && v < 127)
+                    cell << (char) v;
+                else
+                    cell << v;
+            }
+            else
+                cell << setprecision(6) << resultsFloats(view, col)[r];
+            if(csv)
+                cout << (col ? sep : "") << cell.str();
+            else
+                cout << setw(16) << cell.str();
+        }
+        cout << endl;
+    }
+    resultsUnmap(view);
+    return 0;
+}
+
+/***************************************************************************
+* bool parseFilter(const resultsView &view, const char *text, rowFilter &f)
+* Author: Milan Gulati
+* Description: Parses COLUMN=VALUE, COLUMN!=VALUE, COLUMN<VALUE or
+*              COLUMN>VALUE. For the variant column, VALUE may be the
+*              variant letter.
+*
+* Parameters:
+*   view        I/P     const resultsView & Mapped file, for the column names
+*   text        I/P     const char *        Filter as given to -w
+*   f           O/P     rowFilter &         Parsed filter
+*   parseFilter O/P     bool                False if malformed or the column is unknown
+***************************************************************************/
+bool parseFilter(const resultsView &view, const char *text, rowFilter &f)
+{
+    const char *op = strpbrk(text, "=!<>");
+    if(op == NULL || op == text)
+        return false;
+    string name(text, op - text);
+    f.op = *op;
+    const char *value = op + 1;
+    if(f.op == '!')
+    {
+        if(*value != '=')
+            return false;
+        value++;
+    }
+    f.column = resultsFind(view, name.c_str());
+    if(f.column == -1 || *value == '\0')
+        return false;
+
+    if(name == "variant" && value[1] == '\0' && isalpha(value[0]))
+    {
+        f.value = value[0];
+        return true;
+    }
+    char *end;
+    f.value = strtod(value, &end);
+    return *end == '\0';
+}
+
+/***************************************************************************
+* double columnValue(const resultsView &view, int c, long r)
+* Author: Milan Gulati
+* Description: Value of row r of column c, whatever the column's type.
+*
+* Parameters:
+*   view        I/P     const resultsView & Mapped file
+*   c           I/P     int                 Column index
+*   r           I/P     long                Row
+*   columnValue O/P     double              The value
+***************************************************************************/
+double columnValue(const resultsView &view, int c, long r)
+{
+    const long *ints = resultsInts(view, c);
+    if(ints != NULL)
+        return ints[r];
+    return resultsFloats(view, c)[r];
+}
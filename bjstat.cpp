@@ -0,0 +1,189 @@
+/***************************************************************************
+* File: bjstat.cpp
+* Author: Milan Gulati
+* Procedures:
+* main          - attaches to a running simulation's stats page and polls it
+* wilson        - computes a 95% Wilson confidence interval for a win rate
+***************************************************************************/
+
+/* Import Libraries */
+#include <sys/types.h>
+#include <sys/ipc.h>
+#include <sys/shm.h>
+#include <signal.h>
+#include <unistd.h>
+#include <bits/stdc++.h>
+#include <iomanip>
+#include <iostream>
+#include "blackjack_stats.h"
+
+using namespace std;
+
+/* Function Prototypes */
+void wilson(long wins, long games, double &low, double &high);     // 95% confidence interval
+
+/***************************************************************************
+* int main()
+* Author: Milan Gulati
+* Description: Read-only monitor for a simulation started with --stats.
+*              Attaches to the stats page of the chosen variant and prints
+*              progress, throughput, per-seat win rates with confidence
+*              intervals and IPC channel depths every interval. bjstat never
+*              writes to the page, so polling does not slow the dealer.
+*
+*              usage: bjstat [-p | -d] [-i seconds] [-1]
+*                -p   monitor the pipe variant (default is message queues)
+*                -d   monitor the shared deck variant
+*                -i   seconds between samples (default 1)
+*                -1   print one sample and exit
+*
+* Parameters:
+*   argc    I/P     int         Number of arguments on command line
+*   argv    I/P     char *[]    Arguments listed on command line
+*   main    O/P     int         Status code returns 1 if no simulation is found
+***************************************************************************/
+int main(int argc, char *argv[])
+{
+    char variant = 'M';                                 // message queue variant by default
+    double interval = 1.0;                              // seconds between samples
+    bool once = false;                                  // single sample mode
+
+    int c;
+    while((c = getopt(argc, argv, "pdi:1")) != -1)
+    {
+        switch(c)
+        {
+        case 'p':
+            variant = 'P';
+            break;
+        case 'd':
+            variant = 'H';
+            break;
+        case 'i':
+            interval = atof(optarg);
+            break;
+        case '1':
+            once = true;
+            break;
+        default:
+            cerr << "usage: " << argv[0] << " [-p | -d] [-i seconds] [-1]" << endl;
+            return 1;
+        }
+    }
+
+    /* Attach To Stats Page */
+    int shmid = shmget(statsKey(variant), 0, 0);        // existing segment only
+    if(shmid == -1)
+    {
+        cerr << "bjstat: no simulation running with --stats in this directory" << endl;
+        return 1;
+    }
+    void *addr = shmat(shmid, NULL, SHM_RDONLY);        // read only, never disturbs the dealer
+    if(addr == (void *) -1)
+    {
+        cerr << "bjstat: cannot attach stats page" << endl;
+        return 1;
+    }
+    const statsPage *page = (const statsPage *) addr;
+
+    statsPage snap;                                     // current sample
+    long prevGames = 0;                                 // games done at previous sample
+    double prevTime = 0;                                // time of previous sample
+    bool havePrev = false;
+
+    cout << fixed;
+    while(true)
+    {
+        if(!statsSnapshot(page, snap))                  // dealer has not initialised yet
+        {
+            usleep(interval * 1e6);
+            continue;
+        }
+        double now = monotonicNow();
+
+        /* Progress And Throughput */
+        double elapsed = now - snap.startTime;
+        double avgRate = elapsed > 0 ? (snap.gamesDone - snap.gamesFirst) / elapsed : 0;
+        double curRate = avgRate;
+        if(havePrev && now > prevTime)                  // rate over the last interval
+            curRate = (snap.gamesDone - prevGames) / (now - prevTime);
+
+        cout << "\n" << snap.variant << " (pid " << snap.pid << ")"
+             << "  games " << snap.gamesDone << "/" << snap.gamesTotal
+             << " (" << setprecision(1) << 100.0 * snap.gamesDone / snap.gamesTotal << "%)"
+             << "  " << setprecision(0) << curRate << " games/s"
+             << "  avg " << avgRate << " games/s" << endl;
+
+        /* Win Rates With 95% Confidence Interval */
+        for(int s = 0; s <= STATS_SEATS; s++)
+        {
+            long wins = s < STATS_SEATS ? snap.seatWins[s] : snap.dealerWins;
+            double low, high;
+            wilson(wins, snap.gamesDone, low, high);
+            if(s < STATS_SEATS)
+                cout << "  Player " << s + 1 << "  ";
+            else
+                cout << "  Dealer    ";
+            cout << setw(12) << wins << " wins  "
+                 << setprecision(3) << (snap.gamesDone ? 100.0 * wins / snap.gamesDone : 0.0)
+                 << "%  [" << 100.0 * low << "%, " << 100.0 * high << "%]" << endl;
+        }
+
+        /* IPC Channel Depths */
+        if(snap.nqueues > 0)
+        {
+            cout << "  queued bytes:";
+            for(int q = 0; q < snap.nqueues; q++)
+                cout << " " << snap.queueName[q] << "=" << snap.queueDepth[q];
+            cout << endl;
+        }
+
+        if(snap.finished || once)
+            break;
+        if(kill(snap.pid, 0) == -1 && errno == ESRCH)   // dealer died without finishing
+        {
+            cout << "  dealer process is gone" << endl;
+            break;
+        }
+
+        prevGames = snap.gamesDone;
+        prevTime = now;
+        havePrev = true;
+        usleep(interval * 1e6);
+    }
+
+    shmdt(addr);
+    return 0;
+}
+
+/***************************************************************************
+* void wilson(long wins, long games, double &low, double &high)
+* Author: Milan Gulati
+* Description: Computes the 95% Wilson score interval for a win rate. Unlike
+*              the normal approximation it stays inside [0, 1] for small
+*              sample sizes and extreme rates.
+*
+* Parameters:
+*   wins    I/P     long        Number of wins
+*   games   I/P     long        Number of games played
+*   low     O/P     double &    Lower bound of the interval
+*   high    O/P     double &    Upper bound of the interval
+***************************************************************************/
+void wilson(long wins, long games, double &low, double &high)
+{
+    if(games == 0)                                      // nothing played yet
+    {
+        low = 0;
+        high = 1;
+        return;
+    }
+
+    const double z = 1.96;                              // 95% two sided
+    double n = games;
+    double p = wins / n;
+    double denom = 1 + z * z / n;
+    double centre = (p + z * z / (2 * n)) / denom;
+    double half = z * sqrt(p * (1 - p) / n + z * z / (4 * n * n)) / denom;
+    low = max(0.0, centre - half);
+    high = min(1.0, centre + half);
+}
@@ -0,0 +1,216 @@
+/***************************************************************************
+* File: blackjack_affinity.h
+* Author: Milan Gulati
+* Procedures:
+* parseCpuList  - parses a sysfs style cpu list ("0-3,8") into a set
+* readCpuList   - reads a cpu list file from sysfs
+* closeness     - ranks how much cache two cpus share
+* placeTable    - chooses the cpus for the dealer and the two players
+* pinSelf       - pins the calling process to one cpu
+***************************************************************************/
+
+#ifndef BLACKJACK_AFFINITY_H
+#define BLACKJACK_AFFINITY_H
+
+/* Import Libraries */
+#include <sched.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+#include <set>
+#include <string>
+#include <fstream>
+
+#define CPU_SYSFS "/sys/devices/system/cpu/cpu"
+
+/***************************************************************************
+* std::set<int> parseCpuList(const std::string &list)
+* Author: Milan Gulati
+* Description: Parses a cpu list in the kernel's format, e.g. "0-3,8,10-11".
+*
+* Parameters:
+*   list            I/P     const string &  Comma separated cpus and ranges
+*   parseCpuList    O/P     set<int>        Cpus named in the list
+***************************************************************************/
+inline std::set<int> parseCpuList(const std::string &list)
+{
+    std::set<int> cpus;
+    const char *p = list.c_str();
+    while(*p != '\0')
+    {
+        char *end;
+        long lo = strtol(p, &end, 10);
+        if(end == p)                        // not a number, skip it
+        {
+            p++;
+            continue;
+        }
+        long hi = lo;
+        p = end;
+        if(*p == '-')                       // range lo-hi
+        {
+            hi = strtol(p + 1, &end, 10);
+            p = end;
+        }
+        for(long c = lo; c <= hi; c++)
+            cpus.insert(c);
+        if(*p == ',')
+            p++;
+    }
+    return cpus;
+}
+
+/***************************************************************************
+* std::set<int> readCpuList(int cpu, const std::string &file)
+* Author: Milan Gulati
+* Description: Reads a cpu list below /sys/devices/system/cpu/cpuN/.
+*
+* Parameters:
+*   cpu         I/P     int             Cpu whose directory is read
+*   file        I/P     const string &  Path relative to that directory
+*   readCpuList O/P     set<int>        Cpus in the file, empty if it does not exist
+***************************************************************************/
+inline std::set<int> readCpuList(int cpu, const std::string &file)
+{
+    std::ifstream in(CPU_SYSFS + std::to_string(cpu) + "/" + file);
+    std::string line;
+    if(!getline(in, line))
+        return std::set<int>();
+    return parseCpuList(line);
+}
+
+/***************************************************************************
+* int closeness(int a, int b)
+* Author: Milan Gulati
+* Description: Ranks how close two cpus are in the cache hierarchy. Each
+*              card and hit/stand message touches a cache line on both
+*              sides, so the closer the dealer and a player are, the less
+*              that line has to travel.
+*              4 hyperthread siblings, 3 shared L2, 2 shared L3,
+*              1 same package, 0 otherwise.
+*
+* Parameters:
+*   a           I/P     int     First cpu
+*   b           I/P     int     Second cpu
+*   closeness   O/P     int     Rank from 0 (far) to 4 (siblings)
+***************************************************************************/
+inline int closeness(int a, int b)
+{
+    if(readCpuList(a, "topology/thread_siblings_list").count(b))
+        return 4;
+
+    int rank = 0;
+    for(int index = 0; index < 8; index++)  // walk the cache levels of cpu a
+    {
+        std::string dir = "cache/index" + std::to_string(index) + "/";
+        std::ifstream levelFile(CPU_SYSFS + std::to_string(a) + "/" + dir + "level");
+        int level;
+        if(!(levelFile >> level))
+            break;
+        if(readCpuList(a, dir + "shared_cpu_list").count(b))
+        {
+            if(level == 2)
+                rank = std::max(rank, 3);
+            else if(level >= 3)
+                rank = std::max(rank, 2);
+        }
+    }
+    if(rank > 0)
+        return rank;
+
+    std::set<int> package = readCpuList(a, "topology/package_cpus_list");
+    if(package.empty())                     // older kernels
+        package = readCpuList(a, "topology/core_siblings_list");
+    return package.count(b) ? 1 : 0;
+}
+
+/***************************************************************************
+* bool placeTable(const char *spec, int cpus[3])
+* Author: Milan Gulati
+* Description: Chooses a cpu for the dealer, player one and player two.
+*              spec is either "auto" or three cpu numbers "D,P1,P2".
+*              In auto mode the dealer gets the first cpu this process may
+*              run on, and each player gets the allowed cpu closest to the
+*              dealer (see closeness) that is not already taken, so the
+*              chatty dealer/player pairs share the nearest cache level.
+*              Cpus are reused only when there are fewer than three.
+*
+* Parameters:
+*   spec        I/P     const char *    "auto" or "D,P1,P2"
+*   cpus        O/P     int [3]         Cpus for dealer, player 1, player 2
+*   placeTable  O/P     bool            False if spec is invalid or not allowed
+***************************************************************************/
+inline bool placeTable(const char *spec, int cpus[3])
+{
+    cpu_set_t allowed;
+    CPU_ZERO(&allowed);
+    if(sched_getaffinity(0, sizeof(allowed), &allowed) == -1)
+        return false;
+
+    /* Explicit Placement */
+    if(strcmp(spec, "auto") != 0)
+    {
+        if(sscanf(spec, "%d,%d,%d", &cpus[0], &cpus[1], &cpus[2]) != 3)
+            return false;
+        for(int i = 0; i < 3; i++)
+            if(cpus[i] < 0 || cpus[i] >= CPU_SETSIZE || !CPU_ISSET(cpus[i], &allowed))
+                return false;
+        return true;
+    }
+
+    /* Automatic Placement */
+    int dealerCpu = -1;
+    for(int c = 0; c < CPU_SETSIZE && dealerCpu == -1; c++)
+        if(CPU_ISSET(c, &allowed))
+            dealerCpu = c;
+    if(dealerCpu == -1)
+        return false;
+
+    cpus[0] = dealerCpu;
+    std::set<int> taken;
+    taken.insert(dealerCpu);
+    for(int seat = 1; seat <= 2; seat++)
+    {
+        int best = dealerCpu;               // fallback: share the dealer's cpu
+        int bestRank = -1;
+        for(int c = 0; c < CPU_SETSIZE; c++)
+        {
+            if(!CPU_ISSET(c, &allowed) || taken.count(c))
+                continue;
+            int rank = closeness(dealerCpu, c);
+            if(rank > bestRank)             // lowest numbered cpu wins ties
+            {
+                best = c;
+                bestRank = rank;
+            }
+        }
+        cpus[seat] = best;
+        taken.insert(best);
+    }
+    return true;
+}
+
+/***************************************************************************
+* bool pinSelf(int cpu)
+* Author: Milan Gulati
+* Description: Pins the calling process to a single cpu. Does nothing when
+*              cpu is negative (no placement requested). placeTable only
+*              picks allowed cpus, but the cpuset can still change or the
+*              call be refused, so the caller reports a failure.
+*
+* Parameters:
+*   cpu     I/P     int     Cpu to run on, -1 to leave the scheduler in charge
+*   pinSelf O/P     bool    False if the process could not be pinned
+***************************************************************************/
+inline bool pinSelf(int cpu)
+{
+    if(cpu < 0)
+        return true;
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(cpu, &set);
+    return sched_setaffinity(0, sizeof(set), &set) == 0;
+}
+
+#endif
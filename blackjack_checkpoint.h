@@ -0,0 +1,128 @@
+/***************************************************************************
+* File: blackjack_checkpoint.h
+* Author: Milan Gulati
+* Procedures:
+* checkpointSum     - computes the checksum stored in a checkpoint
+* checkpointSave    - atomically writes a checkpoint file
+* checkpointLoad    - reads and validates a checkpoint file
+***************************************************************************/
+
+#ifndef BLACKJACK_CHECKPOINT_H
+#define BLACKJACK_CHECKPOINT_H
+
+/* Import Libraries */
+#include <fcntl.h>
+#include <unistd.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <string.h>
+
+#define CHECKPOINT_MAGIC    0x424a434b50543031L     // "BJCKPT01"
+#define CHECKPOINT_VERSION  2                       // 2 added rules and the net tally
+
+/*
+* checkpoint is the fixed size binary record written to the checkpoint file
+* games are dealt from (seed, game index) alone, so nextGame is the whole
+* random stream position; resuming replays nothing before it
+*/
+struct checkpoint
+{
+    long magic;                             // CHECKPOINT_MAGIC
+    int version;                            // CHECKPOINT_VERSION
+    char variant;                           // 'M' message queues, 'P' pipes, 'H' shared deck
+    unsigned long seed;                     // seed of the run
+    long gamesTotal;                        // games requested for the run
+    long nextGame;                          // first game not yet played
+    long p1Wins;                            // player one wins so far
+    long p2Wins;                            // player two wins so far
+    long dealerWins;                        // dealer wins so far
+    int rules;                              // RULE_* bits the run plays with
+    long p1Hands;                           // hands played by player one so far
+    long p2Hands;                           // hands played by player two so far
+    long p1Net;                             // player one's net result so far, in half units
+    long p2Net;                             // player two's net result so far, in half units
+    unsigned long sum;                      // checksum of every field above
+};
+
+/***************************************************************************
+* unsigned long checkpointSum(const checkpoint &ckpt)
+* Author: Milan Gulati
+* Description: FNV-1a hash of the record up to (not including) sum. Catches
+*              truncated or corrupted checkpoint files.
+*
+* Parameters:
+*   ckpt            I/P     const checkpoint &  Record to hash
+*   checkpointSum   O/P     unsigned long       Checksum of the record
+***************************************************************************/
+inline unsigned long checkpointSum(const checkpoint &ckpt)
+{
+    const unsigned char *p = (const unsigned char *) &ckpt;
+    unsigned long h = 0xcbf29ce484222325UL;
+    for(size_t i = 0; i < offsetof(checkpoint, sum); i++)
+    {
+        h ^= p[i];
+        h *= 0x100000001b3UL;
+    }
+    return h;
+}
+
+/***************************************************************************
+* bool checkpointSave(const char *path, checkpoint &ckpt)
+* Author: Milan Gulati
+* Description: Writes the checkpoint to path.tmp, flushes it to disk and
+*              renames it over path. A crash while saving leaves the
+*              previous checkpoint intact.
+*
+* Parameters:
+*   path            I/P     const char *    Checkpoint file name
+*   ckpt            I/P     checkpoint &    Record to save (magic and sum are filled in)
+*   checkpointSave  O/P     bool            False if the file could not be written
+***************************************************************************/
+inline bool checkpointSave(const char *path, checkpoint &ckpt)
+{
+    char tmp[4096];
+    snprintf(tmp, sizeof(tmp), "%s.tmp", path);
+
+    ckpt.magic = CHECKPOINT_MAGIC;
+    ckpt.version = CHECKPOINT_VERSION;
+    ckpt.sum = checkpointSum(ckpt);
+
+    int fd = open(tmp, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if(fd == -1)
+        return false;
+    bool ok = write(fd, &ckpt, sizeof(ckpt)) == (ssize_t) sizeof(ckpt);
+    ok = fsync(fd) == 0 && ok;              // data on disk before the rename
+    close(fd);
+
+    if(!ok || rename(tmp, path) == -1)
+    {
+        unlink(tmp);
+        return false;
+    }
+    return true;
+}
+
+/***************************************************************************
+* bool checkpointLoad(const char *path, checkpoint &ckpt)
+* Author: Milan Gulati
+* Description: Reads a checkpoint written by checkpointSave and checks its
+*              magic, version and checksum.
+*
+* Parameters:
+*   path            I/P     const char *    Checkpoint file name
+*   ckpt            O/P     checkpoint &    Record read from the file
+*   checkpointLoad  O/P     bool            False if missing or invalid
+***************************************************************************/
+inline bool checkpointLoad(const char *path, checkpoint &ckpt)
+{
+    int fd = open(path, O_RDONLY);
+    if(fd == -1)
+        return false;
+    bool ok = read(fd, &ckpt, sizeof(ckpt)) == (ssize_t) sizeof(ckpt);
+    close(fd);
+
+    return ok && ckpt.magic == CHECKPOINT_MAGIC && ckpt.version == CHECKPOINT_VERSION
+              && ckpt.sum == checkpointSum(ckpt);
+}
+
+#endif
@@ -0,0 +1,360 @@
+/***************************************************************************
+* File: blackjack_dealercache.h
+* Author: Milan Gulati
+* Procedures:
+* shoeUnseen        - counts the cards the dealer has not shown yet
+* oddsKey           - packs a dealer hand and shoe composition into 64 bits
+* oddsRules         - tabulates the variant's hand value and dealer rule
+* dealerDraw        - recursive step of dealerOutcome
+* dealerOutcome     - exact distribution of the dealer's final total (memoized)
+* expectedWins      - expected wins of a game given the dealer's distribution
+* estimateAdd       - adds one game to the variance reduced estimator
+* estimateReport    - prints counted and expected win rates side by side
+***************************************************************************/
+
+#ifndef BLACKJACK_DEALERCACHE_H
+#define BLACKJACK_DEALERCACHE_H
+
+/* Import Libraries */
+#include <math.h>
+#include <string.h>
+#include <iomanip>
+#include <iostream>
+#include <vector>
+#include "blackjack_deck.h"
+
+#define ODDS_FINALS     6                   // dealer ends on 17, 18, 19, 20, 21 or busts
+#define ODDS_BUST       5                   // index of bust in dealerOdds
+#define ODDS_SLOTS      (1 << 18)           // cache entries (14 MB), cleared when 3/4 full
+#define ODDS_SUMS       32                  // non ace sums a dealer hand can reach (at most 26)
+#define ODDS_ACES       5                   // aces a dealer hand can hold (at most 4)
+
+// probability of each final dealer total: 17, 18, 19, 20, 21, bust
+struct dealerOdds
+{
+    double p[ODDS_FINALS];
+};
+
+/*
+* dealerCache memoizes dealerOutcome in an open addressing table
+* the key is the dealer's hand (sum of non aces, number of aces) and the
+* rank counts of the cards it can still draw; handValue() depends on the
+* hand only through those two numbers, so equal keys have equal outcomes
+* the dealer process owns the cache; agents keep it across shards
+*/
+struct dealerCache
+{
+    std::vector<unsigned long> keys;        // oddsKey + 1, 0 marks an empty slot
+    std::vector<dealerOdds> odds;           // outcome for the key in the same slot
+    long used;                              // slots filled
+    long hits;                              // lookups answered from the table
+    long misses;                            // lookups that had to recurse
+    int (*value)(const std::vector<char> &); // the hand value function (blackjack_game.h)
+    bool (*draws)(int);                     // the variant's dealer rule
+    int total[ODDS_SUMS][ODDS_ACES];        // handValue by non ace sum and aces
+    bool hit[ODDS_SUMS][ODDS_ACES];         // dealer rule applied to total
+};
+
+/*
+* estimate accumulates the expected wins of each game: the probability each
+* side wins given everything except the dealer's hole card and draws,
+* averaged exactly over those unseen cards; it has the same mean as counting
+* wins but less variance (Rao-Blackwell), so it needs fewer games for the
+* same confidence
+*/
+struct estimate
+{
+    long games;                             // games added
+    double expected[3];                     // sum of expected wins (p1, p2, dealer)
+    double expectedSq[3];                   // sum of squared expected wins
+};
+
+/***************************************************************************
+* void shoeUnseen(const char cards[], int spot, int counts[RANKS])
+* Author: Milan Gulati
+* Description: Counts, per rank, the cards the players have not seen when
+*              the dealer starts its turn: the hole card (cards[1]) and
+*              everything from spot on. The shuffle is uniform, so given
+*              what was seen these are in random order.
+*
+* Parameters:
+*   cards       I/P     const char []   Deck of the current game
+*   spot        I/P     int             First card not yet dealt to a player
+*   counts      O/P     int [RANKS]     Unseen cards per rank
+***************************************************************************/
+inline void shoeUnseen(const char cards[], int spot, int counts[RANKS])
+{
+    memset(counts, 0, RANKS * sizeof(int));
+    counts[rankIndex(cards[1])]++;
+    for(int c = spot; c < DECK_SIZE; c++)
+        counts[rankIndex(cards[c])]++;
+}
+
+/***************************************************************************
+* unsigned long oddsKey(const int counts[RANKS], int nonAces, int aces)
+* Author: Milan Gulati
+* Description: Packs a dealer state into 40 bits: 3 bits for aces and each
+*              of 2..9 (at most 4 each), 5 bits for tens (at most 16), then
+*              5 bits for the hand's non ace sum and 3 for its aces.
+*
+* Parameters:
+*   counts      I/P     const int [RANKS]   Cards left per rank
+*   nonAces     I/P     int                 Sum of the hand's non ace cards
+*   aces        I/P     int                 Number of aces in the hand
+*   oddsKey     O/P     unsigned long       Packed key
+***************************************************************************/
+inline unsigned long oddsKey(const int counts[RANKS], int nonAces, int aces)
+{
+    unsigned long key = 0;
+    for(int r = 0; r < RANKS - 1; r++)
+        key = key << 3 | counts[r];
+    key = key << 5 | counts[RANKS - 1];
+    key = key << 5 | nonAces;
+    return key << 3 | aces;
+}
+
+/***************************************************************************
+* void oddsRules(dealerCache &cache)
+* Author: Milan Gulati
+* Description: Tabulates the variant's handValue and dealer rule for every
+*              (non ace sum, aces) pair, so the recursion neither builds
+*              hands nor calls handValue. Each pair is evaluated on a
+*              representative hand: the aces plus 2..9 cards adding up to
+*              the non ace sum (any sum but 1 can be made that way, and a
+*              sum of 1 cannot occur).
+*
+* Parameters:
+*   cache   I/O     dealerCache &   Cache whose total and hit tables are filled
+***************************************************************************/
+inline void oddsRules(dealerCache &cache)
+{
+    for(int nonAces = 0; nonAces < ODDS_SUMS; nonAces++)
+    {
+        for(int aces = 0; aces < ODDS_ACES; aces++)
+        {
+            std::vector<char> hand(aces, 'A');
+            int rest = nonAces;
+            while(rest > 0)
+            {
+                int card = rest >= 11 ? 9 : (rest == 1 ? 2 : rest);   // 2..9 only
+                if(rest - card == 1)                                // never leave a 1
+                    card--;
+                hand.push_back('0' + card);
+                rest -= card;
+            }
+            cache.total[nonAces][aces] = cache.value(hand);
+            cache.hit[nonAces][aces] = cache.draws(cache.total[nonAces][aces]);
+        }
+    }
+}
+
+/***************************************************************************
+* dealerOdds dealerDraw(dealerCache &cache, int counts[RANKS], int left,
+*                       int nonAces, int aces)
+* Author: Milan Gulati
+* Description: Recursive step of dealerOutcome. If the dealer hits on its
+*              hand, every rank left is drawn with probability
+*              count / cards left. Standing hands are cheap and not stored.
+*
+* Parameters:
+*   cache       I/O     dealerCache &       Memo table
+*   counts      I/O     int [RANKS]         Cards left per rank (restored on return)
+*   left        I/P     int                 Sum of counts
+*   nonAces     I/P     int                 Sum of the hand's non ace cards
+*   aces        I/P     int                 Number of aces in the hand
+*   dealerDraw  O/P     dealerOdds          Distribution of the final total
+***************************************************************************/
+inline dealerOdds dealerDraw(dealerCache &cache, int counts[RANKS], int left, int nonAces, int aces)
+{
+    dealerOdds out;
+    memset(&out, 0, sizeof(out));
+
+    if(!cache.hit[nonAces][aces] || left == 0)      // dealer stands (or the deck is spent)
+    {
+        int val = cache.total[nonAces][aces];
+        out.p[val > 21 ? ODDS_BUST : (val < 17 ? 0 : val - 17)] = 1.0;    // a spent deck counts as 17
+        return out;
+    }
+
+    /* Look Up */
+    unsigned long key = oddsKey(counts, nonAces, aces) + 1;
+    size_t mask = ODDS_SLOTS - 1;
+    size_t slot = (key * 0x9E3779B97F4A7C15UL) >> 46 & mask;   // fibonacci hash, top 18 bits
+    while(cache.keys[slot] != 0)
+    {
+        if(cache.keys[slot] == key)
+        {
+            cache.hits++;
+            return cache.odds[slot];
+        }
+        slot = (slot + 1) & mask;
+    }
+    cache.misses++;
+
+    /* Draw Every Rank */
+    for(int r = 0; r < RANKS; r++)
+    {
+        if(counts[r] == 0)
+            continue;
+        double chance = (double) counts[r] / left;
+        int nextSum = r == 0 ? nonAces : nonAces + (r == 9 ? 10 : r + 1);
+        int nextAces = r == 0 ? aces + 1 : aces;
+        if(!cache.hit[nextSum][nextAces] || left == 1)     // stands: no need to recurse
+        {
+            int val = cache.total[nextSum][nextAces];
+            out.p[val > 21 ? ODDS_BUST : (val < 17 ? 0 : val - 17)] += chance;
+            continue;
+        }
+        counts[r]--;
+        dealerOdds next = dealerDraw(cache, counts, left - 1, nextSum, nextAces);
+        counts[r]++;
+        for(int f = 0; f < ODDS_FINALS; f++)
+            out.p[f] += chance * next.p[f];
+    }
+
+    /* Store */
+    if(cache.used >= ODDS_SLOTS / 4 * 3)    // keep probe chains short: start over
+    {
+        std::fill(cache.keys.begin(), cache.keys.end(), 0UL);
+        cache.used = 0;
+    }
+    slot = (key * 0x9E3779B97F4A7C15UL) >> 46 & mask;  // the recursion may have moved things
+    while(cache.keys[slot] != 0)
+        slot = (slot + 1) & mask;
+    cache.keys[slot] = key;
+    cache.odds[slot] = out;
+    cache.used++;
+    return out;
+}
+
+/***************************************************************************
+* dealerOdds dealerOutcome(dealerCache &cache, int counts[RANKS], char upcard)
+* Author: Milan Gulati
+* Description: Exact distribution of the dealer's final total given its
+*              upcard and the composition of the cards it has not shown,
+*              instead of playing the draw loop out once. The hole card is
+*              just the first of those unseen cards to be drawn. The cache
+*              is created on first use with the variant's rules.
+*
+* Parameters:
+*   cache           I/O     dealerCache &   Memo table
+*   counts          I/O     int [RANKS]     Unseen cards per rank (restored on return)
+*   upcard          I/P     char            Dealer's face up card (cards[0])
+*   dealerOutcome   O/P     dealerOdds      Probability of 17..21 and bust
+***************************************************************************/
+inline dealerOdds dealerOutcome(dealerCache &cache, int counts[RANKS], char upcard)
+{
+    if(cache.keys.empty())
+    {
+        cache.keys.assign(ODDS_SLOTS, 0UL);
+        cache.odds.resize(ODDS_SLOTS);
+        oddsRules(cache);
+    }
+    int left = 0;
+    for(int r = 0; r < RANKS; r++)
+        left += counts[r];
+    int r = rankIndex(upcard);
+    if(r == 0)
+        return dealerDraw(cache, counts, left, 0, 1);
+    return dealerDraw(cache, counts, left, r == 9 ? 10 : r + 1, 0);
+}
+
+/***************************************************************************
+* void expectedWins(const dealerOdds &odds, int valP1, int valP2, double out[3])
+* Author: Milan Gulati
+* Description: Applies the win rules of the dealer's "Determine Wins" block
+*              to every final dealer total, weighted by its probability.
+*
+* Parameters:
+*   odds    I/P     const dealerOdds &  Distribution of the dealer's final total
+*   valP1   I/P     int                 Player one's final hand
+*   valP2   I/P     int                 Player two's final hand
+*   out     O/P     double [3]          Expected wins of p1, p2 and the dealer
+***************************************************************************/
+inline void expectedWins(const dealerOdds &odds, int valP1, int valP2, double out[3])
+{
+    out[0] = out[1] = out[2] = 0.0;
+    for(int f = 0; f < ODDS_FINALS; f++)
+    {
+        double p = odds.p[f];
+        if(p == 0.0)
+            continue;
+        if(f == ODDS_BUST)                                  // dealer busts
+        {
+            if(valP1 <= 21)
+                out[0] += p;
+            if(valP2 <= 21)
+                out[1] += p;
+            if(valP1 > 21 || valP2 > 21)
+                out[2] += p;
+        }
+        else                                                // dealer <= 21
+        {
+            int valDealer = 17 + f;
+            if(valP1 <= 21 && valP1 > valDealer)
+                out[0] += p;
+            if(valP2 <= 21 && valP2 > valDealer)
+                out[1] += p;
+            if(valP1 < valDealer || valP2 < valDealer)
+                out[2] += p;
+        }
+    }
+}
+
+/***************************************************************************
+* void estimateAdd(estimate &est, const double expected[3])
+* Author: Milan Gulati
+* Description: Adds the expected wins of one game.
+*
+* Parameters:
+*   est         I/O     estimate &          Running sums
+*   expected    I/P     const double [3]    Expected wins of this game
+***************************************************************************/
+inline void estimateAdd(estimate &est, const double expected[3])
+{
+    est.games++;
+    for(int s = 0; s < 3; s++)
+    {
+        est.expected[s] += expected[s];
+        est.expectedSq[s] += expected[s] * expected[s];
+    }
+}
+
+/***************************************************************************
+* void estimateReport(const estimate &est, const long counted[3], const dealerCache &cache)
+* Author: Milan Gulati
+* Description: Prints, for each side, the expected and counted win rate over
+*              the same games with the 95% half width of each (normal
+*              approximation), and how often the dealer cache answered
+*              without recursing.
+*
+* Parameters:
+*   est     I/P     const estimate &        Running sums
+*   counted I/P     const long [3]          Wins counted over the same games
+*   cache   I/P     const dealerCache &     Cache whose hit rate is shown
+***************************************************************************/
+inline void estimateReport(const estimate &est, const long counted[3], const dealerCache &cache)
+{
+    if(est.games == 0)
+        return;
+    const char *names[3] = {"Player One:        ", "Player Two:        ", "Dealer:            "};
+    double n = est.games;
+
+    std::cout << "----------------------------------------------" << std::endl;
+    std::cout << "Expected Wins (dealer averaged over its unseen cards, " << est.games << " games)" << std::endl;
+    std::cout << std::fixed << std::setprecision(3);
+    for(int s = 0; s < 3; s++)
+    {
+        double pc = counted[s] / n;                         // counted: Bernoulli variance
+        double pe = est.expected[s] / n;
+        double ve = est.expectedSq[s] / n - pe * pe;
+        std::cout << names[s] << 100.0 * pe << "% +/- " << 196.0 * sqrt(ve / n)
+                  << "% | counted " << 100.0 * pc << "% +/- " << 196.0 * sqrt(pc * (1 - pc) / n) << "%" << std::endl;
+    }
+    std::cout.unsetf(std::ios::fixed);
+    long lookups = cache.hits + cache.misses;
+    std::cout << "Dealer Cache:      " << cache.used << " entries | "
+              << std::setprecision(4) << (lookups ? 100.0 * cache.hits / lookups : 0.0) << "% hits" << std::endl;
+}
+
+#endif
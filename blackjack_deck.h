@@ -0,0 +1,131 @@
+/***************************************************************************
+* File: blackjack_deck.h
+* Author: Milan Gulati
+* Procedures:
+* splitmix64    - advances a splitmix64 state and returns the next random value
+* gameState     - computes the random stream start for one game
+* boundedRand   - maps a random value onto [0, bound) without division
+* shuffleDeck   - deals the deck for one game in a reproducible order
+* rankIndex     - maps a card char to its rank slot (A, 2..9, T)
+***************************************************************************/
+
+#ifndef BLACKJACK_DECK_H
+#define BLACKJACK_DECK_H
+
+/* Import Libraries */
+#include <string.h>
+
+#define DECK_SIZE 52                        // cards in a single deck
+#define RANKS     10                        // A, 2, 3, 4, 5, 6, 7, 8, 9, T
+
+/*
+* deckOrder[] is the unshuffled deck every game starts from
+* 'A' represents Ace for a value of either 1 or 11
+* 'T' represents 10, Jack, Queen, King for a value of 10
+*  All other cards are at face value
+*/
+static const char deckOrder[DECK_SIZE] = {'2', '2', '2', '2', '3', '3', '3', '3', '4', '4', '4', '4', '5', '5', '5', '5',
+                                          '6', '6', '6', '6', '7', '7', '7', '7', '8', '8', '8', '8', '9', '9', '9', '9',
+                                          'T', 'T', 'T', 'T', 'T', 'T', 'T', 'T', 'T', 'T', 'T', 'T', 'T', 'T', 'T', 'T',
+                                          'A', 'A', 'A', 'A'};
+
+static const char rankCards[RANKS] = {'A', '2', '3', '4', '5', '6', '7', '8', '9', 'T'};
+
+/***************************************************************************
+* unsigned long splitmix64(unsigned long &state)
+* Author: Milan Gulati
+* Description: splitmix64 generator. The state is a plain counter, so any
+*              position in the stream can be reached without replaying it.
+*
+* Parameters:
+*   state       I/P     unsigned long &     Generator state, advanced by one step
+*   splitmix64  O/P     unsigned long       Next 64 bit random value
+***************************************************************************/
+inline unsigned long splitmix64(unsigned long &state)
+{
+    unsigned long z = (state += 0x9E3779B97F4A7C15UL);
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9UL;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBUL;
+    return z ^ (z >> 31);
+}
+
+/***************************************************************************
+* unsigned long gameState(unsigned long seed, long game)
+* Author: Milan Gulati
+* Description: Computes the generator state that game number game starts
+*              from. Every game has its own stream, so the deck of any game
+*              depends only on (seed, game) and not on the games before it.
+*              This is what lets a run resume from a checkpoint, or be split
+*              across processes, and still deal the exact same cards.
+*
+* Parameters:
+*   seed        I/P     unsigned long   Seed of the whole run
+*   game        I/P     long            Index of the game in the run
+*   gameState   O/P     unsigned long   Starting state for splitmix64
+***************************************************************************/
+inline unsigned long gameState(unsigned long seed, long game)
+{
+    unsigned long state = seed ^ ((unsigned long) game * 0xD1B54A32D192ED03UL);
+    return splitmix64(state);               // scramble so nearby games are unrelated
+}
+
+/***************************************************************************
+* unsigned int boundedRand(unsigned long r, unsigned int bound)
+* Author: Milan Gulati
+* Description: Maps a random value onto [0, bound) with a multiply and a
+*              shift instead of a modulo. Uses the top 32 bits of r; for the
+*              bounds used here (<= 52) the bias is below 1 in 80 million.
+*
+* Parameters:
+*   r           I/P     unsigned long   64 bit random value
+*   bound       I/P     unsigned int    Size of the range
+*   boundedRand O/P     unsigned int    Value in [0, bound)
+***************************************************************************/
+inline unsigned int boundedRand(unsigned long r, unsigned int bound)
+{
+    return (unsigned int) (((r >> 32) * bound) >> 32);
+}
+
+/***************************************************************************
+* void shuffleDeck(char cards[], unsigned long seed, long game)
+* Author: Milan Gulati
+* Description: Resets cards[] to the unshuffled deck and applies a
+*              Fisher-Yates shuffle driven by the game's own random stream.
+*
+* Parameters:
+*   cards   O/P     char []         Deck of DECK_SIZE cards for this game
+*   seed    I/P     unsigned long   Seed of the whole run
+*   game    I/P     long            Index of the game in the run
+***************************************************************************/
+inline void shuffleDeck(char cards[], unsigned long seed, long game)
+{
+    memcpy(cards, deckOrder, DECK_SIZE);
+    unsigned long state = gameState(seed, game);
+    for(int j = DECK_SIZE - 1; j > 0; j--)
+    {
+        unsigned int k = boundedRand(splitmix64(state), j + 1);
+        char temp = cards[j];               // swap card j with a card at or below it
+        cards[j] = cards[k];
+        cards[k] = temp;
+    }
+}
+
+/***************************************************************************
+* int rankIndex(char card)
+* Author: Milan Gulati
+* Description: Maps a card char to its slot in a rank count array.
+*
+* Parameters:
+*   card        I/P     char    'A', '2'..'9' or 'T'
+*   rankIndex   O/P     int     0 for aces, 1..8 for 2..9, 9 for tens
+***************************************************************************/
+inline int rankIndex(char card)
+{
+    if(card == 'A')
+        return 0;
+    if(card == 'T')
+        return 9;
+    return card - '1';
+}
+
+#endif
@@ -0,0 +1,371 @@
+/***************************************************************************
+* File: blackjack_dist.h
+* Author: Milan Gulati
+* Procedures:
+* sendAll           - writes a whole buffer to a socket
+* recvAll           - reads a whole buffer from a socket
+* connectAgent      - opens a TCP connection to one agent
+* runAgent          - serves shards to a coordinator (agent mode)
+* runCoordinator    - splits a run into shards and farms them out (coordinator mode)
+***************************************************************************/
+
+#ifndef BLACKJACK_DIST_H
+#define BLACKJACK_DIST_H
+
+/* Import Libraries */
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+#include <netdb.h>
+#include <poll.h>
+#include <errno.h>
+#include <string.h>
+#include <unistd.h>
+#include <deque>
+#include <string>
+#include <vector>
+#include <iostream>
+#include "blackjack_options.h"
+#include "blackjack_stats.h"
+
+#define SHARD_MAGIC 0x424a534841524431L     // "BJSHARD1"
+
+/*
+* a shard is the half open game range [first, last) of a run
+* decks are dealt from (seed, game index) alone, so any agent playing a
+* shard deals exactly the cards a single local run would have dealt
+* both structs are sent as raw bytes: coordinator and agents must share
+* the same architecture (all agents on one box or one cluster of x86-64)
+*/
+struct shardRequest
+{
+    long magic;                             // SHARD_MAGIC
+    unsigned long seed;                     // seed of the whole run
+    long first;                             // first game of the shard
+    long last;                              // one past the last game
+};
+
+struct shardResult
+{
+    long magic;                             // SHARD_MAGIC
+    long first;                             // echo of the request
+    long last;                              // echo of the request
+    long wins[3];                           // player one, player two, dealer wins
+    long ok;                                // 0 if the agent could not play the shard
+};
+
+// plays opts.first .. opts.games on the local engine and adds to wins
+typedef bool (*tableRunner)(simOptions &opts, long wins[3]);
+
+/***************************************************************************
+* bool sendAll(int fd, const void *buf, size_t len)
+* Author: Milan Gulati
+* Description: Writes len bytes to a socket, retrying short writes. Uses
+*              MSG_NOSIGNAL so a vanished peer is an error, not SIGPIPE.
+*
+* Parameters:
+*   fd      I/P     int             Connected socket
+*   buf     I/P     const void *    Bytes to send
+*   len     I/P     size_t          Number of bytes
+*   sendAll O/P     bool            False if the connection failed
+***************************************************************************/
+inline bool sendAll(int fd, const void *buf, size_t len)
+{
+    const char *p = (const char *) buf;
+    while(len > 0)
+    {
+        ssize_t n = send(fd, p, len, MSG_NOSIGNAL);
+        if(n <= 0)
+            return false;
+        p += n;
+        len -= n;
+    }
+    return true;
+}
+
+/***************************************************************************
+* bool recvAll(int fd, void *buf, size_t len)
+* Author: Milan Gulati
+* Description: Reads exactly len bytes from a socket, retrying short reads.
+*
+* Parameters:
+*   fd      I/P     int         Connected socket
+*   buf     O/P     void *      Buffer for the bytes
+*   len     I/P     size_t      Number of bytes
+*   recvAll O/P     bool        False on error or if the peer closed
+***************************************************************************/
+inline bool recvAll(int fd, void *buf, size_t len)
+{
+    char *p = (char *) buf;
+    while(len > 0)
+    {
+        ssize_t n = recv(fd, p, len, 0);
+        if(n <= 0)
+            return false;
+        p += n;
+        len -= n;
+    }
+    return true;
+}
+
+/***************************************************************************
+* int connectAgent(const std::string &addr)
+* Author: Milan Gulati
+* Description: Connects to an agent given as host:port.
+*
+* Parameters:
+*   addr            I/P     const string &  Agent address, host:port
+*   connectAgent    O/P     int             Connected socket, -1 on failure
+***************************************************************************/
+inline int connectAgent(const std::string &addr)
+{
+    size_t colon = addr.rfind(':');
+    if(colon == std::string::npos)
+        return -1;
+    std::string host = addr.substr(0, colon);
+    std::string port = addr.substr(colon + 1);
+
+    struct addrinfo hints, *res;
+    memset(&hints, 0, sizeof(hints));
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    if(getaddrinfo(host.c_str(), port.c_str(), &hints, &res) != 0)
+        return -1;
+
+    int fd = -1;
+    for(struct addrinfo *ai = res; ai != NULL; ai = ai->ai_next)
+    {
+        fd = socket(ai->ai_family, ai->ai_socktype, ai->ai_protocol);
+        if(fd == -1)
+            continue;
+        if(connect(fd, ai->ai_addr, ai->ai_addrlen) == 0)
+            break;
+        close(fd);
+        fd = -1;
+    }
+    freeaddrinfo(res);
+
+    if(fd != -1)
+    {
+        int one = 1;                        // requests are tiny, send them at once
+        setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+    }
+    return fd;
+}
+
+/***************************************************************************
+* int runAgent(simOptions &opts, tableRunner run)
+* Author: Milan Gulati
+* Description: Agent mode. Listens on opts.bind:opts.agentPort and plays
+*              every shard a coordinator sends on the local dealer/player
+*              engine, one shard at a time, replying with the shard's win
+*              counts. A request whose range is empty, negative or larger
+*              than SHARD_MAX_GAMES is answered as failed without playing.
+*              Runs until killed; a coordinator disconnecting is not an
+*              error, but the listening socket failing is.
+*
+* Parameters:
+*   opts        I/P     simOptions &    Run configuration (seed and range are set per shard)
+*   run         I/P     tableRunner     Local engine of this variant
+*   runAgent    O/P     int             Status code returns 1 if the port cannot be opened or accept fails
+***************************************************************************/
+inline int runAgent(simOptions &opts, tableRunner run)
+{
+    int lfd = socket(AF_INET, SOCK_STREAM, 0);
+    if(lfd == -1)
+        return 1;
+    int one = 1;
+    setsockopt(lfd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+
+    struct sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(opts.agentPort);
+    if(inet_pton(AF_INET, opts.bind, &addr.sin_addr) != 1
+       || bind(lfd, (struct sockaddr *) &addr, sizeof(addr)) == -1 || listen(lfd, 8) == -1)
+    {
+        std::cerr << "agent: cannot listen on " << opts.bind << ":" << opts.agentPort << std::endl;
+        close(lfd);
+        return 1;
+    }
+    std::cerr << "agent: listening on " << opts.bind << ":" << opts.agentPort << std::endl;
+
+    while(true)
+    {
+        int fd = accept(lfd, NULL, NULL);
+        if(fd == -1)
+        {
+            if(errno == EINTR || errno == ECONNABORTED)
+                continue;                   // that connection only, keep serving
+            std::cerr << "agent: accept failed: " << strerror(errno) << std::endl;
+            close(lfd);
+            return 1;
+        }
+        setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+
+        shardRequest req;
+        while(recvAll(fd, &req, sizeof(req)) && req.magic == SHARD_MAGIC)
+        {
+            shardResult res;
+            memset(&res, 0, sizeof(res));
+            res.magic = SHARD_MAGIC;
+            res.first = req.first;
+            res.last = req.last;
+
+            if(req.first >= 0 && req.first < req.last && req.last - req.first <= SHARD_MAX_GAMES)
+            {
+                opts.seed = req.seed;       // play exactly the requested games
+                opts.first = req.first;
+                opts.games = req.last;
+                res.ok = run(opts, res.wins);
+            }
+            else
+                std::cerr << "agent: rejected games " << req.first << "-" << req.last - 1 << std::endl;
+
+            if(!sendAll(fd, &res, sizeof(res)))
+                break;                      // coordinator went away
+        }
+        close(fd);
+    }
+}
+
+/***************************************************************************
+* int runCoordinator(simOptions &opts, long wins[3])
+* Author: Milan Gulati
+* Description: Coordinator mode. Splits games [opts.first, opts.games) into
+*              shards of opts.shard games and hands them to the agents in
+*              opts.agents, keeping one shard in flight per agent. If an
+*              agent fails (connection refused, reset or closed) or has not
+*              answered within opts.timeout seconds, its connection is
+*              dropped and its shard goes back on the queue for the
+*              remaining agents.
+*
+* Parameters:
+*   opts            I/P     simOptions &    Run configuration and agent list
+*   wins            I/O     long [3]        Win counts, shard results are added
+*   runCoordinator  O/P     int             Status code returns 1 if every agent failed
+***************************************************************************/
+inline int runCoordinator(simOptions &opts, long wins[3])
+{
+    /* Connect To Agents */
+    std::vector<std::string> names;         // host:port of each agent
+    std::string list = opts.agents;
+    size_t start = 0;
+    while(start <= list.size())
+    {
+        size_t comma = list.find(',', start);
+        if(comma == std::string::npos)
+            comma = list.size();
+        if(comma > start)
+            names.push_back(list.substr(start, comma - start));
+        start = comma + 1;
+    }
+
+    size_t n = names.size();
+    std::vector<int> fds(n, -1);            // socket per agent, -1 once failed
+    std::vector<long> busy(n, -1);          // first game of the shard in flight, -1 if idle
+    std::vector<long> busyLast(n, 0);       // end of the shard in flight
+    std::vector<double> deadline(n, 0);     // when the shard in flight is given up on
+    for(size_t a = 0; a < n; a++)
+    {
+        fds[a] = connectAgent(names[a]);
+        if(fds[a] == -1)
+            std::cerr << "coordinator: cannot reach agent " << names[a] << std::endl;
+    }
+
+    /* Split Run Into Shards */
+    std::deque<std::pair<long, long> > pending;
+    for(long first = opts.first; first < opts.games; first += opts.shard)
+        pending.push_back(std::make_pair(first, std::min(first + opts.shard, opts.games)));
+    size_t remaining = pending.size();      // shards without a result yet
+
+    while(remaining > 0)
+    {
+        /* Hand Out Work */
+        for(size_t a = 0; a < n; a++)
+        {
+            if(fds[a] == -1 || busy[a] != -1 || pending.empty())
+                continue;
+            shardRequest req = {SHARD_MAGIC, opts.seed, pending.front().first, pending.front().second};
+            if(sendAll(fds[a], &req, sizeof(req)))
+            {
+                busy[a] = req.first;
+                busyLast[a] = req.last;
+                deadline[a] = monotonicNow() + opts.timeout;
+                pending.pop_front();
+            }
+            else                            // agent died while idle
+            {
+                std::cerr << "coordinator: agent " << names[a] << " failed" << std::endl;
+                close(fds[a]);
+                fds[a] = -1;
+            }
+        }
+
+        /* Wait For Results */
+        std::vector<struct pollfd> pfds;
+        std::vector<size_t> owner;
+        double now = monotonicNow();
+        double wait = 1e6;                  // until the nearest deadline, in ms it still fits an int
+        for(size_t a = 0; a < n; a++)
+        {
+            if(fds[a] != -1 && busy[a] != -1)
+            {
+                struct pollfd p = {fds[a], POLLIN, 0};
+                pfds.push_back(p);
+                owner.push_back(a);
+                wait = std::min(wait, deadline[a] - now);
+            }
+        }
+        if(pfds.empty())                    // work left but no agent alive
+        {
+            std::cerr << "coordinator: no agents left, " << remaining << " shards unplayed" << std::endl;
+            for(size_t a = 0; a < n; a++)
+                if(fds[a] != -1)
+                    close(fds[a]);
+            return 1;
+        }
+        if(poll(pfds.data(), pfds.size(), wait > 0 ? (int) (wait * 1000) + 1 : 0) == -1)
+            continue;
+
+        now = monotonicNow();
+        for(size_t i = 0; i < pfds.size(); i++)
+        {
+            size_t a = owner[i];
+            bool silent = pfds[i].revents == 0;
+            if(silent && now < deadline[a])
+                continue;                   // still playing its shard
+
+            // a silent agent past its deadline is stuck (e.g. a player died
+            // and its dealer blocks forever) with the connection still open
+            shardResult res;
+            if(!silent && recvAll(fds[a], &res, sizeof(res)) && res.magic == SHARD_MAGIC && res.ok
+               && res.first == busy[a] && res.last == busyLast[a])
+            {
+                for(int w = 0; w < 3; w++)
+                    wins[w] += res.wins[w];
+                remaining--;
+                busy[a] = -1;
+            }
+            else                            // agent died mid shard: reassign it
+            {
+                std::cerr << "coordinator: agent " << names[a] << (silent ? " timed out" : " failed")
+                          << ", reassigning games "
+                          << busy[a] << "-" << busyLast[a] - 1 << std::endl;
+                pending.push_front(std::make_pair(busy[a], busyLast[a]));
+                close(fds[a]);
+                fds[a] = -1;
+                busy[a] = -1;
+            }
+        }
+    }
+
+    for(size_t a = 0; a < n; a++)
+        if(fds[a] != -1)
+            close(fds[a]);
+    return 0;
+}
+
+#endif
@@ -0,0 +1,624 @@
+/***************************************************************************
+* File: blackjack_game.h
+* Author: Milan Gulati
+* Procedures:
+* playerOne     - player one hit/stand strategy (hit when < 15)
+* playerTwo     - player two hit/stand strategy (hit when < 18)
+* dealer        - dealer hit/stand rules (hit when < 17)
+* handValue     - computes integer value of hand vector
+* rulesParse    - parses a --rules list into RULE_* bits
+* rulesName     - spells out a set of rules
+* rulesBuild    - builds the hand state and strategy tables for a set of rules
+* seatDecide    - one player decision, read from the tables
+* playSeat      - plays every hand of one seat, with cards from the caller's dealer
+* dealerPlay    - dealer draws to its final hand by the tables
+* settleSeat    - scores one seat's hands against the dealer
+* playGame      - plays one whole game in process
+* rulesReport   - prints the rules and each seat's net result
+***************************************************************************/
+
+#ifndef BLACKJACK_GAME_H
+#define BLACKJACK_GAME_H
+
+/* Import Libraries */
+#include <string.h>
+#include <algorithm>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <vector>
+#include "blackjack_deck.h"
+
+/*
+* the game kernels every variant plays with, kept in one place so the
+* three programs and bjbench always run the same rules
+*/
+
+#define RULE_H17        1                   // dealer hits soft 17
+#define RULE_DOUBLE     2                   // double on any first two cards, also after a split
+#define RULE_SPLIT      4                   // split pairs, up to SEAT_HANDS hands
+#define RULE_SURRENDER  8                   // give up half the stake instead of playing the first two cards
+#define RULE_ALL        (RULE_H17 | RULE_DOUBLE | RULE_SPLIT | RULE_SURRENDER)
+
+#define DEC_STAND       0                   // stand (on the wire: the player's turn is over)
+#define DEC_HIT         1                   // one more card (true in the original hit/stand protocol)
+#define DEC_DOUBLE      2                   // double the stake, take one card and stand
+#define DEC_SPLIT       3                   // split a pair into two hands, one new card each
+#define DEC_SURRENDER   4                   // give up the hand for half the stake
+#define DEC_CODES       5
+
+#define SEAT_HANDS      4                   // hands one seat can split into
+#define HAND_STATES     64                  // hard total 0..31, plus 32 once the hand holds an ace
+#define KIND_SOFT       32                  // strategy rows: hard totals 0..31, soft totals from 32,
+#define KIND_PAIR       64                  // pairs from 64 by rank,
+#define KIND_NOPAIR     (KIND_PAIR + RANKS) // and an all stand row for hands that cannot split
+#define HAND_KINDS      (KIND_NOPAIR + 1)
+
+static const int decisionCards[DEC_CODES] = {0, 1, 1, 2, 0};   // cards the dealer deals for each decision
+static const char *const ruleNames[] = {"h17", "double", "split", "surrender"};  // RULE_* bits in order
+
+/*
+* seatResult is what a player hands the dealer at the end of its turn: the
+* final value of every hand it played and what rides on it; fixed size, so
+* every transport sends it as one message
+*/
+struct seatResult
+{
+    int hands;                              // hands played, 1 unless the seat split
+    int value[SEAT_HANDS];                  // final value of each hand
+    int stake[SEAT_HANDS];                  // units bet on each hand, 2 once doubled
+    int surrendered[SEAT_HANDS];            // non zero if the hand was given up
+};
+
+/*
+* netTally is the money side of a run next to the win counts: the hands each
+* seat played and its net result, in half units so surrenders stay exact
+*/
+struct netTally
+{
+    long hands[2];                          // hands played by player 1, player 2
+    long halves[2];                         // net result in half units
+};
+
+/*
+* ruleTables is the game under one set of rules as lookups. A hand is a
+* state (hard total, holds an ace) and each card moves it to the next state;
+* a decision is read from the row of the hand's kind (hard total, soft total
+* or pair) and the column of the dealer's upcard. The loops that play a hand
+* keep no hand value or rule logic of their own, so doubling, splitting and
+* surrender cost a few more table reads per decision, not more branches.
+* About 4 KB, built once per run before the processes fork.
+*/
+struct ruleTables
+{
+    int rules;                              // RULE_* bits the tables were built for
+    unsigned fresh;                         // decisions (bit per DEC_*) allowed on two new cards
+    unsigned char rank[128];                // rankIndex by card char
+    unsigned char next[HAND_STATES][RANKS]; // state after drawing a card of each rank
+    unsigned char value[HAND_STATES];       // handValue of a hand in the state
+    unsigned char kind[HAND_STATES];        // strategy row: hard total, or KIND_SOFT + soft total
+    unsigned char dealerHits[HAND_STATES];  // the dealer draws in this state
+    unsigned char move[2][HAND_KINDS][RANKS];       // each seat's play by hand kind and upcard
+    unsigned char fallback[2][HAND_KINDS][RANKS];   // its play when the move is not allowed
+};
+
+/*
+* deckDeal deals a seat's cards straight from the deck, for the shared deck
+* variant and games played in process; the IPC variants deal through their
+* own transports with the same operator()
+*/
+struct deckDeal
+{
+    const char *cards;                      // deck of the game
+    int *spot;                              // next card to draw, shared by every seat
+
+    void operator()(int code, char got[2])
+    {
+        got[0] = cards[*spot];
+        got[1] = code == DEC_SPLIT ? cards[*spot + 1] : 0;
+        *spot += decisionCards[code];
+    }
+};
+
+/***************************************************************************
+* int playerOne(int val)
+* Author: Milan Gulati
+* Description: Player one's hit/stand strategy. Hits when less than 15.
+*              Stands when greater than equal to 15.
+*              Hit returns true. Stand returns false.
+*
+* Parameters:
+*   val         I/P     int     Integer value of current hand  
+*   playerOne   O/P     bool    Hit or stand signal for player one process
+***************************************************************************/
+inline bool playerOne(int val)
+{
+    if(val < 15)    // hit if hand < 15
+        return true;
+    return false;   // stand otherwise
+}
+
+/***************************************************************************
+* int playerTwo(int val)
+* Author: Milan Gulati
+* Description: Player two's hit/stand strategy. Hits when less than 18.
+*              Stands when greater than equal to 18.
+*              Hit returns true. Stand returns false.
+*
+* Parameters:
+*   val         I/P     int     Integer value of current hand  
+*   playerTwo   O/P     bool    Hit or stand signal for player two process
+***************************************************************************/
+inline bool playerTwo(int val)
+{
+    if(val < 18)    // hit if hand < 18
+        return true;
+    return false;   // stand otherwise
+}
+
+/***************************************************************************
+* int dealer(int val)
+* Author: Milan Gulati
+* Description: Dealer's hit/stand rule. Hits when less than 17.
+*              Stands when greater than equal to 17.
+*              Hit returns true. Stand returns false.
+*
+* Parameters:
+*   val         I/P     int     Integer value of current hand  
+*   dealer      O/P     bool    Hit or stand signal for dealer process
+***************************************************************************/
+inline bool dealer(int val)
+{
+    if(val < 17)    // hit if hand < 17
+        return true;
+    return false;   // stand otherwise
+}
+
+/***************************************************************************
+* int handValue(const vector<char> &hand)
+* Author: Milan Gulati
+* Description: Computes the integer value of the hand vector argument.
+*              Aces are treated specially and are dependent on the value of the
+*              other cards in the hand, and how many other aces are in the hand.
+*
+* Parameters:
+*   hand        I/P     const vector<char> &    Vector of chars containing cards in current hand 
+*   handValue   O/P     int                     Integer value of hand computed from vector hand
+***************************************************************************/
+inline int handValue(const std::vector<char> &hand)
+{
+    int sum = 0;                                        // running sum of hand
+    int aces = std::count(hand.begin(), hand.end(), 'A');    // occurences of 'A' in vector
+
+    // if aces exist in hand
+    if(aces > 0)
+    {
+        // iterate through hand and sum non-ace values
+        for(auto c: hand)
+        {
+            if(c != 'A')                                // card must not be an ace
+            {
+                if(c == 'T')                            // 'T' equivalent to 10,J,Q,K
+                    sum += 10;                          // add to sum
+                else                                    // treat all other cards as face value
+                {
+                    int val = c - '0';                  // convert char to int
+                    sum += val;                         // add to sum
+                }
+            }
+        }
+
+        // remaining cards are aces
+        // depending on how many aces are present
+        // the values will be treated as 1 for each ace accordingly
+        switch (aces)
+        {
+        case 1: /* One Ace: 1 or 11 */
+            if(sum <= 10)                               // if existing sum is able to fit 11 (blackjack if sum = 10!)
+                sum += 11;
+            else                                        // else treat aces as 1
+                sum += 1;
+            break;
+        case 2: /* Two Ace: 2 or 12 */
+            if(sum <= 9)                                // existing sum able to fit 12 (11, 1)
+                sum += 12;
+            else                                        // else treat aces as 1 (1, 1)
+                sum += 2;
+            break;
+        case 3: /* Three Ace: 3 or 13 */
+            if(sum <= 8)                                // existing sum able to fit 13 (11, 1, 1)
+                sum += 13;
+            else                                        // else treat aces as 1 (1, 1, 1)
+                sum += 3;
+            break;
+        case 4: /* Four Ace: 4 or 14 */
+            if(sum <= 7)                                // existing sum able to fit 14 (11, 1, 1, 1)
+                sum += 14;
+            else                                        // else treat aces as 1 (1, 1, 1, 1)
+                sum += 4;
+            break;
+        default:                                        // default case will not occur
+            break;
+        }
+    }
+
+    // else no aces exist in hand
+    else 
+    {
+        // iterate though hand and sum up every value
+        // no need to account for aces in this case
+        for(auto c: hand)
+        {
+            if(c == 'T')                                // 'T' equivalent to 10,J,Q,K
+                sum += 10;                              // add to sum
+            else                                        // treat all other cards as face value
+            {
+                int val = c - '0';                      // convert char to int
+                sum += val;                             // add to sum
+            }
+        }
+    }
+    return sum;                                         // return sum of hand
+}
+
+/***************************************************************************
+* int rulesParse(const char *list)
+* Author: Milan Gulati
+* Description: Parses a comma separated list of h17, double, split and
+*              surrender (or all, or none) into RULE_* bits.
+*
+* Parameters:
+*   list        I/P     const char *    List as given to --rules
+*   rulesParse  O/P     int             RULE_* bits, -1 on an unknown name
+***************************************************************************/
+inline int rulesParse(const char *list)
+{
+    int rules = 0;
+    while(*list != '\0')
+    {
+        size_t len = strcspn(list, ",");
+        std::string name(list, len);
+        int bit = name == "all" ? RULE_ALL : name == "none" ? 0 : -1;
+        for(int r = 0; r < 4; r++)
+            if(name == ruleNames[r])
+                bit = 1 << r;
+        if(bit == -1)
+            return -1;
+        rules |= bit;
+        list += len + (list[len] == ',');
+    }
+    return rules;
+}
+
+/***************************************************************************
+* std::string rulesName(int rules)
+* Author: Milan Gulati
+* Description: The rules as rulesParse reads them, "none" for the plain
+*              hit/stand game.
+*
+* Parameters:
+*   rules       I/P     int             RULE_* bits
+*   rulesName   O/P     std::string     Comma separated rule names
+***************************************************************************/
+inline std::string rulesName(int rules)
+{
+    std::string name;
+    for(int r = 0; r < 4; r++)
+        if(rules & (1 << r))
+            name += (name.empty() ? "" : ",") + std::string(ruleNames[r]);
+    return name.empty() ? "none" : name;
+}
+
+/***************************************************************************
+* void rulesBuild(ruleTables &t, int rules)
+* Author: Milan Gulati
+* Description: Builds the tables for a set of rules. A hand's value is its
+*              hard total, plus 10 when it holds an ace and that fits (the
+*              same value handValue computes); a hand is soft when it does.
+*              Each seat starts from its hit/stand strategy for every
+*              total, which is all the plain game uses. Each rule then
+*              overlays the textbook plays it allows:
+*                double     hard 11 against 2-10, hard 10 against 2-9,
+*                           hard 9 against 3-6, soft 13-14 against 5-6,
+*                           soft 15-16 against 4-6, soft 17 against 3-6,
+*                           wherever the seat would otherwise hit
+*                split      aces and eights always, 2s 3s and 7s against
+*                           2-7, 6s against 2-6, 4s against 5-6, 9s
+*                           against 2-6 and 8-9
+*                surrender  hard 16 against 9, 10 and ace, hard 15
+*                           against 10
+*              A move that is not allowed any more (a double after a hit)
+*              falls back to the seat's own hit/stand play.
+*
+* Parameters:
+*   t           O/P     ruleTables &    Tables to fill
+*   rules       I/P     int             RULE_* bits
+***************************************************************************/
+inline void rulesBuild(ruleTables &t, int rules)
+{
+    memset(&t, 0, sizeof(t));
+    t.rules = rules;
+    t.fresh = (rules & RULE_DOUBLE ? 1 << DEC_DOUBLE : 0) | (rules & RULE_SPLIT ? 1 << DEC_SPLIT : 0)
+            | (rules & RULE_SURRENDER ? 1 << DEC_SURRENDER : 0);
+    for(int r = 0; r < RANKS; r++)
+        t.rank[(unsigned char) rankCards[r]] = r;
+
+    /* Hand States */
+    for(int s = 0; s < HAND_STATES; s++)
+    {
+        int hard = s & 31;                              // aces counted as 1
+        bool ace = s >= 32;
+        bool soft = ace && hard <= 11;                  // one ace can count 11
+        int val = soft ? hard + 10 : hard;
+        t.value[s] = val;
+        t.kind[s] = soft ? KIND_SOFT + val : val;
+        t.dealerHits[s] = dealer(val) || ((rules & RULE_H17) && soft && val == 17);
+        for(int r = 0; r < RANKS; r++)                  // rank r is worth r + 1, aces 1
+            t.next[s][r] = std::min(hard + r + 1, 31) | (ace || r == 0 ? 32 : 0);
+    }
+
+    /* Strategies */
+    bool (*const seats[2])(int) = {playerOne, playerTwo};
+    for(int p = 0; p < 2; p++)
+    {
+        unsigned char (*move)[RANKS] = t.move[p];
+        unsigned char (*fallback)[RANKS] = t.fallback[p];
+        for(int k = 0; k < KIND_PAIR; k++)              // pair rows stay DEC_STAND: no split
+            for(int up = 0; up < RANKS; up++)
+                move[k][up] = fallback[k][up] = seats[p](k & 31) ? DEC_HIT : DEC_STAND;
+
+        for(int up = 0; up < RANKS; up++)
+        {
+            int u = up == 0 ? 11 : up + 1;              // upcard value, aces high
+
+            if(rules & RULE_DOUBLE)
+            {
+                bool dbl[KIND_PAIR] = {};
+                dbl[11] = u <= 10;
+                dbl[10] = u <= 9;
+                dbl[9] = u >= 3 && u <= 6;
+                dbl[KIND_SOFT + 13] = dbl[KIND_SOFT + 14] = u == 5 || u == 6;
+                dbl[KIND_SOFT + 15] = dbl[KIND_SOFT + 16] = u >= 4 && u <= 6;
+                dbl[KIND_SOFT + 17] = u >= 3 && u <= 6;
+                for(int k = 0; k < KIND_PAIR; k++)
+                    if(dbl[k] && move[k][up] == DEC_HIT)
+                        move[k][up] = DEC_DOUBLE;
+            }
+
+            if(rules & RULE_SPLIT)                      // by rank: A 2 3 4 5 6 7 8 9 T
+            {
+                bool split[RANKS] = {true, u <= 7, u <= 7, u == 5 || u == 6, false,
+                                     u <= 6, u <= 7, true, u <= 6 || u == 8 || u == 9, false};
+                for(int r = 0; r < RANKS; r++)
+                    move[KIND_PAIR + r][up] = split[r] ? DEC_SPLIT : DEC_STAND;
+            }
+
+            if(rules & RULE_SURRENDER)
+            {
+                if(u >= 9)
+                    move[16][up] = DEC_SURRENDER;
+                if(u == 10)
+                    move[15][up] = DEC_SURRENDER;
+            }
+        }
+    }
+}
+
+/***************************************************************************
+* int seatDecide(const ruleTables &t, int seat, int state, int pairRow, int up, unsigned allowed)
+* Author: Milan Gulati
+* Description: One decision of a seat: the split row wins when the hand may
+*              split, otherwise the move for the hand's kind, replaced by
+*              the fallback when the rules or the hand do not allow it.
+*              Two table reads and two conditional moves, no branches.
+*
+* Parameters:
+*   t           I/P     const ruleTables &  Tables of the run
+*   seat        I/P     int                 0 for player one, 1 for player two
+*   state       I/P     int                 Hand state
+*   pairRow     I/P     int                 KIND_PAIR + rank if the hand may split, else KIND_NOPAIR
+*   up          I/P     int                 Rank of the dealer's upcard
+*   allowed     I/P     unsigned            Decisions allowed now, a bit per DEC_*
+*   seatDecide  O/P     int                 DEC_* code
+***************************************************************************/
+inline int seatDecide(const ruleTables &t, int seat, int state, int pairRow, int up, unsigned allowed)
+{
+    int kind = t.kind[state];
+    int code = t.move[seat][kind][up];
+    code = t.move[seat][pairRow][up] == DEC_SPLIT ? DEC_SPLIT : code;
+    return (allowed >> code) & 1 ? code : t.fallback[seat][kind][up];
+}
+
+/***************************************************************************
+* void playSeat(const ruleTables &t, int seat, const char first[2], char upcard,
+*               Deal &deal, seatResult &out)
+* Author: Milan Gulati
+* Description: Plays all of a seat's hands. deal(code, got) is called for
+*              every decision that takes cards (hit, double, split) and
+*              fills got with decisionCards[code] cards; stands and
+*              surrenders take none and are only reported in out. Hands are
+*              played in order, a split adding its second hand at the end.
+*              Double and surrender need two new cards; surrender is only
+*              offered before any split; split aces get one card each and
+*              are not split again.
+*
+* Parameters:
+*   t           I/P     const ruleTables &  Tables of the run
+*   seat        I/P     int                 0 for player one, 1 for player two
+*   first       I/P     const char [2]      The seat's first two cards
+*   upcard      I/P     char                The dealer's upcard
+*   deal        I/O     Deal &              Source of the cards each decision takes
+*   out         O/P     seatResult &        Hands played, for the dealer
+***************************************************************************/
+template <class Deal>
+inline void playSeat(const ruleTables &t, int seat, const char first[2], char upcard, Deal &deal, seatResult &out)
+{
+    int up = t.rank[(unsigned char) upcard];
+    int state[SEAT_HANDS];                              // hand states
+    int pair[SEAT_HANDS];                               // rank of a two card pair, -1 otherwise
+    int count[SEAT_HANDS];                              // cards in each hand
+    int a = t.rank[(unsigned char) first[0]];
+    int b = t.rank[(unsigned char) first[1]];
+    state[0] = t.next[t.next[0][a]][b];
+    pair[0] = a == b ? a : -1;
+    count[0] = 2;
+    out.hands = 1;
+    bool splitAces = false;                             // split aces stand on their one card
+
+    for(int h = 0; h < out.hands; h++)
+    {
+        out.stake[h] = 1;
+        out.surrendered[h] = 0;
+        while(!splitAces)
+        {
+            unsigned allowed = (1 << DEC_STAND) | (1 << DEC_HIT);
+            if(count[h] == 2)                           // two new cards: the rules' extras
+                allowed |= t.fresh & (out.hands == 1 ? ~0u : ~(1u << DEC_SURRENDER));
+            bool canSplit = (allowed >> DEC_SPLIT & 1) && pair[h] >= 0 && out.hands < SEAT_HANDS;
+            int code = seatDecide(t, seat, state[h], canSplit ? KIND_PAIR + pair[h] : KIND_NOPAIR, up, allowed);
+            if(code == DEC_STAND || code == DEC_SURRENDER)
+            {
+                out.surrendered[h] = code == DEC_SURRENDER;
+                break;
+            }
+
+            char got[2];
+            deal(code, got);                            // the cards the decision takes
+            if(code == DEC_SPLIT)                       // one card to each half of the pair
+            {
+                int r = pair[h];
+                int n = out.hands++;
+                a = t.rank[(unsigned char) got[0]];
+                b = t.rank[(unsigned char) got[1]];
+                state[h] = t.next[t.next[0][r]][a];
+                state[n] = t.next[t.next[0][r]][b];
+                pair[h] = a == r ? r : -1;
+                pair[n] = b == r ? r : -1;
+                count[h] = count[n] = 2;
+                splitAces = r == 0;
+                continue;
+            }
+            state[h] = t.next[state[h]][t.rank[(unsigned char) got[0]]];
+            count[h]++;
+            if(code == DEC_DOUBLE)                      // one card only
+            {
+                out.stake[h] = 2;
+                break;
+            }
+        }
+        out.value[h] = t.value[state[h]];
+    }
+}
+
+/***************************************************************************
+* int dealerPlay(const ruleTables &t, const char cards[], int &spot)
+* Author: Milan Gulati
+* Description: The dealer's hand: its two cards (cards 0 and 1) and draws
+*              from spot on while the tables say it hits (below 17, and on
+*              soft 17 under h17).
+*
+* Parameters:
+*   t           I/P     const ruleTables &  Tables of the run
+*   cards       I/P     const char []       Deck of the game
+*   spot        I/O     int &               Next card, moved past the dealer's draws
+*   dealerPlay  O/P     int                 Final value of the dealer's hand
+***************************************************************************/
+inline int dealerPlay(const ruleTables &t, const char cards[], int &spot)
+{
+    int state = t.next[t.next[0][t.rank[(unsigned char) cards[0]]]][t.rank[(unsigned char) cards[1]]];
+    while(t.dealerHits[state])
+        state = t.next[state][t.rank[(unsigned char) cards[spot++]]];
+    return t.value[state];
+}
+
+/***************************************************************************
+* long settleSeat(const seatResult &seat, int valDealer, bool &dealerWon)
+* Author: Milan Gulati
+* Description: Scores each of a seat's hands against the dealer. Money: a
+*              bust loses the stake, otherwise a hand beating the dealer (or
+*              any hand when the dealer busts) wins it, a lower hand loses
+*              it, a tie pushes, and a surrender loses half a unit. The
+*              dealer's win follows the original rules hand by hand: it wins
+*              the game if it busts and some hand busted too, or stands and
+*              beats some hand (a surrendered hand counts as beaten).
+*
+* Parameters:
+*   seat        I/P     const seatResult &  The seat's hands
+*   valDealer   I/P     int                 Final value of the dealer's hand
+*   dealerWon   I/O     bool &              Set if the dealer wins against one of the hands
+*   settleSeat  O/P     long                Net result of the seat in half units
+***************************************************************************/
+inline long settleSeat(const seatResult &seat, int valDealer, bool &dealerWon)
+{
+    long halves = 0;
+    bool dealerBust = valDealer > 21;
+    for(int h = 0; h < seat.hands; h++)
+    {
+        int v = seat.value[h];
+        bool bust = v > 21;
+        bool given = seat.surrendered[h] != 0;
+        int win = !bust && (dealerBust || v > valDealer);
+        int lose = bust || (!dealerBust && v < valDealer);
+        halves += given ? -1 : 2 * seat.stake[h] * (win - lose);
+        dealerWon |= given || (dealerBust && bust) || (!dealerBust && v < valDealer);
+    }
+    return halves;
+}
+
+/***************************************************************************
+* void playGame(const ruleTables &t, const char cards[], long wins[3], netTally &net)
+* Author: Milan Gulati
+* Description: Plays one game without any processes: the cards are taken
+*              from the same deck positions as in the variants (dealer 0-1,
+*              player one 2-3, player two 4-5, then draws in turn order)
+*              and scored like the dealer scores them. A seat wins the game
+*              when it comes out ahead.
+*
+* Parameters:
+*   t           I/P     const ruleTables &  Tables of the run
+*   cards       I/P     const char []       Shuffled deck of the game
+*   wins        I/O     long [3]            Wins of player 1, player 2 and the dealer
+*   net         I/O     netTally &          Hands and net result of each seat
+***************************************************************************/
+inline void playGame(const ruleTables &t, const char cards[], long wins[3], netTally &net)
+{
+    int spot = 6;
+    deckDeal deal = {cards, &spot};
+    seatResult seats[2];
+    playSeat(t, 0, cards + 2, cards[0], deal, seats[0]);
+    playSeat(t, 1, cards + 4, cards[0], deal, seats[1]);
+    int valDealer = dealerPlay(t, cards, spot);
+
+    bool dealerWon = false;
+    for(int p = 0; p < 2; p++)
+    {
+        long halves = settleSeat(seats[p], valDealer, dealerWon);
+        wins[p] += halves > 0;
+        net.hands[p] += seats[p].hands;
+        net.halves[p] += halves;
+    }
+    wins[2] += dealerWon;
+}
+
+/***************************************************************************
+* void rulesReport(int rules, const netTally &net, long games)
+* Author: Milan Gulati
+* Description: Prints the rules played and each seat's net result in units
+*              (one unit bet per hand, two on a double), in total and per
+*              game, below the win counts.
+*
+* Parameters:
+*   rules       I/P     int                 RULE_* bits of the run
+*   net         I/P     const netTally &    Hands and net result of each seat
+*   games       I/P     long                Games the tally covers
+***************************************************************************/
+inline void rulesReport(int rules, const netTally &net, long games)
+{
+    const char *labels[2] = {"Player One Net:    ", "Player Two Net:    "};
+    std::cout << "Rules:             " << rulesName(rules) << std::endl;
+    for(int p = 0; p < 2; p++)
+        std::cout << labels[p] << std::setprecision(8) << net.halves[p] / 2.0 << " units | Per Game: "
+                  << std::setprecision(4) << net.halves[p] / 2.0 / games << " | Hands: " << net.hands[p] << std::endl;
+}
+
+#endif
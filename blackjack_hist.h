@@ -0,0 +1,277 @@
+/***************************************************************************
+* File: blackjack_hist.h
+* Author: Milan Gulati
+* Procedures:
+* traceClock    - reads CLOCK_MONOTONIC in nanoseconds
+* histBucket    - maps a latency to its histogram bucket
+* histLow       - lowest latency counted in a bucket
+* histRecord    - adds one latency to a histogram
+* histMerge     - adds one histogram into another
+* histPercentile- latency below which a given fraction of samples fall
+* traceCreate   - maps the shared latency histograms (before fork)
+* traceReport   - prints percentiles and writes the raw bucket file
+***************************************************************************/
+
+#ifndef BLACKJACK_HIST_H
+#define BLACKJACK_HIST_H
+
+/* Import Libraries */
+#include <sys/mman.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <iomanip>
+#include <iostream>
+
+#define HIST_SUB        32                      // buckets per power of two (~3% resolution)
+#define HIST_SHIFT      5                       // log2(HIST_SUB)
+#define HIST_BUCKETS    (HIST_SUB * 38)         // covers up to 2^42 ns, over an hour
+
+/*
+* trace channels, each written by exactly one process:
+* the dealer times card sent -> hit/stand received for each seat,
+* each player times hit sent -> card received
+*/
+#define TRACE_DEALER_P1 0                       // dealer: card to p1 -> decision from p1
+#define TRACE_DEALER_P2 1                       // dealer: card to p2 -> decision from p2
+#define TRACE_P1        2                       // player one: hit -> next card
+#define TRACE_P2        3                       // player two: hit -> next card
+#define TRACE_CHANNELS  4
+
+/*
+* latencyHist is a log-linear (HDR style) histogram of nanosecond latencies
+* values below 2 * HIST_SUB get a bucket each; above that every power of two
+* is split into HIST_SUB equal buckets, so the relative error stays under
+* 1 / HIST_SUB at any magnitude while the table stays a fixed 10 KB
+*/
+struct latencyHist
+{
+    long count;                                 // samples recorded
+    long sum;                                   // sum of samples (ns) for the mean
+    long min;                                   // smallest sample (ns)
+    long max;                                   // largest sample (ns)
+    long buckets[HIST_BUCKETS];                 // samples per bucket
+};
+
+// one histogram per channel, in a MAP_SHARED page inherited across fork()
+struct latencyTrace
+{
+    latencyHist hist[TRACE_CHANNELS];
+};
+
+static const char *traceNames[TRACE_CHANNELS] = {"dealer->p1", "dealer->p2", "p1->dealer", "p2->dealer"};
+
+/***************************************************************************
+* long traceClock()
+* Author: Milan Gulati
+* Description: Reads CLOCK_MONOTONIC in nanoseconds. The clock is system
+*              wide and served from the vDSO, so stamping costs tens of
+*              nanoseconds and no system call.
+*
+* Parameters:
+*   traceClock  O/P     long    Current monotonic time in nanoseconds
+***************************************************************************/
+inline long traceClock()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000000L + ts.tv_nsec;
+}
+
+/***************************************************************************
+* int histBucket(long ns)
+* Author: Milan Gulati
+* Description: Maps a latency to its bucket. With e = msb(ns) - HIST_SHIFT,
+*              the bucket is e * HIST_SUB + (ns >> e), which keeps the top
+*              HIST_SHIFT + 1 bits of the value.
+*
+* Parameters:
+*   ns          I/P     long    Latency in nanoseconds
+*   histBucket  O/P     int     Bucket index, clamped to the last bucket
+***************************************************************************/
+inline int histBucket(long ns)
+{
+    if(ns < 2 * HIST_SUB)
+        return ns < 0 ? 0 : (int) ns;
+    int e = 63 - __builtin_clzl(ns) - HIST_SHIFT;
+    long b = (long) e * HIST_SUB + (ns >> e);
+    return b < HIST_BUCKETS ? (int) b : HIST_BUCKETS - 1;
+}
+
+/***************************************************************************
+* long histLow(int bucket)
+* Author: Milan Gulati
+* Description: Inverse of histBucket: the smallest latency in a bucket. The
+*              bucket holds latencies up to histLow(bucket + 1) - 1.
+*
+* Parameters:
+*   bucket      I/P     int     Bucket index
+*   histLow     O/P     long    Lowest latency (ns) counted in the bucket
+***************************************************************************/
+inline long histLow(int bucket)
+{
+    if(bucket < 2 * HIST_SUB)
+        return bucket;
+    int e = bucket / HIST_SUB - 1;
+    return (long) (bucket % HIST_SUB + HIST_SUB) << e;
+}
+
+/***************************************************************************
+* void histRecord(latencyHist &h, long ns)
+* Author: Milan Gulati
+* Description: Adds one latency sample. Each histogram has a single writer,
+*              so no atomics are needed.
+*
+* Parameters:
+*   h       I/O     latencyHist &   Histogram to add to
+*   ns      I/P     long            Latency in nanoseconds
+***************************************************************************/
+inline void histRecord(latencyHist &h, long ns)
+{
+    if(h.count == 0 || ns < h.min)
+        h.min = ns;
+    if(ns > h.max)
+        h.max = ns;
+    h.count++;
+    h.sum += ns;
+    h.buckets[histBucket(ns)]++;
+}
+
+/***************************************************************************
+* void histMerge(latencyHist &dst, const latencyHist &src)
+* Author: Milan Gulati
+* Description: Adds every sample of src into dst. Buckets line up exactly,
+*              so merging loses no precision.
+*
+* Parameters:
+*   dst     I/O     latencyHist &           Histogram added to
+*   src     I/P     const latencyHist &     Histogram added
+***************************************************************************/
+inline void histMerge(latencyHist &dst, const latencyHist &src)
+{
+    if(src.count == 0)
+        return;
+    if(dst.count == 0 || src.min < dst.min)
+        dst.min = src.min;
+    if(src.max > dst.max)
+        dst.max = src.max;
+    dst.count += src.count;
+    dst.sum += src.sum;
+    for(int b = 0; b < HIST_BUCKETS; b++)
+        dst.buckets[b] += src.buckets[b];
+}
+
+/***************************************************************************
+* long histPercentile(const latencyHist &h, double q)
+* Author: Milan Gulati
+* Description: Returns the highest latency of the bucket holding the q-th
+*              quantile, capped at the recorded maximum (HDR reports the
+*              same "highest equivalent value").
+*
+* Parameters:
+*   h               I/P     const latencyHist &     Histogram to query
+*   q               I/P     double                  Quantile, 0.0 to 1.0
+*   histPercentile  O/P     long                    Latency in nanoseconds, 0 if empty
+***************************************************************************/
+inline long histPercentile(const latencyHist &h, double q)
+{
+    if(h.count == 0)
+        return 0;
+    long rank = (long) (q * h.count + 0.5);     // samples at or below the answer
+    if(rank < 1)
+        rank = 1;
+    long seen = 0;
+    for(int b = 0; b < HIST_BUCKETS; b++)
+    {
+        seen += h.buckets[b];
+        if(seen >= rank)
+        {
+            long high = histLow(b + 1) - 1;
+            return high < h.max ? high : h.max;
+        }
+    }
+    return h.max;
+}
+
+/***************************************************************************
+* latencyTrace *traceCreate()
+* Author: Milan Gulati
+* Description: Maps zeroed histograms shared with every process forked
+*              afterwards. The dealer and each player write only their own
+*              channels, and the dealer reads them all once the players
+*              have exited.
+*
+* Parameters:
+*   traceCreate O/P     latencyTrace *  Shared histograms, NULL on failure
+***************************************************************************/
+inline latencyTrace *traceCreate()
+{
+    void *mem = mmap(NULL, sizeof(latencyTrace), PROT_READ | PROT_WRITE,
+                     MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+    if(mem == MAP_FAILED)
+        return NULL;
+    return (latencyTrace *) mem;                // anonymous pages are already zero
+}
+
+/***************************************************************************
+* bool traceReport(const latencyTrace *trace, const char *path)
+* Author: Milan Gulati
+* Description: Prints count, mean and p50/p90/p99/p99.9/max of every
+*              channel, plus both dealer channels merged, in microseconds.
+*              Writes the raw non-empty buckets of every channel to path as
+*              "channel low_ns high_ns count" lines, so runs can be merged
+*              or plotted later without losing resolution.
+*
+* Parameters:
+*   trace       I/P     const latencyTrace *    Histograms to report
+*   path        I/P     const char *            Raw bucket file to write
+*   traceReport O/P     bool                    False if the file cannot be written
+***************************************************************************/
+inline bool traceReport(const latencyTrace *trace, const char *path)
+{
+    latencyHist all;                            // both seats as the dealer sees them
+    memset(&all, 0, sizeof(all));
+    histMerge(all, trace->hist[TRACE_DEALER_P1]);
+    histMerge(all, trace->hist[TRACE_DEALER_P2]);
+
+    const latencyHist *rows[TRACE_CHANNELS + 1];
+    const char *names[TRACE_CHANNELS + 1];
+    for(int c = 0; c < TRACE_CHANNELS; c++)
+    {
+        rows[c] = &trace->hist[c];
+        names[c] = traceNames[c];
+    }
+    rows[TRACE_CHANNELS] = &all;
+    names[TRACE_CHANNELS] = "dealer all";
+
+    std::cout << "----------------------------------------------" << std::endl;
+    std::cout << "Hit round trip (us)   count     mean      p50      p90      p99    p99.9      max" << std::endl;
+    std::cout << std::fixed << std::setprecision(2);
+    for(int c = 0; c <= TRACE_CHANNELS; c++)
+    {
+        const latencyHist &h = *rows[c];
+        double mean = h.count ? (double) h.sum / h.count : 0.0;
+        std::cout << std::left << std::setw(16) << names[c] << std::right
+                  << std::setw(12) << h.count
+                  << std::setw(9) << mean / 1000
+                  << std::setw(9) << histPercentile(h, 0.50) / 1000.0
+                  << std::setw(9) << histPercentile(h, 0.90) / 1000.0
+                  << std::setw(9) << histPercentile(h, 0.99) / 1000.0
+                  << std::setw(9) << histPercentile(h, 0.999) / 1000.0
+                  << std::setw(9) << h.max / 1000.0 << std::endl;
+    }
+    std::cout.unsetf(std::ios::fixed);
+
+    FILE *f = fopen(path, "w");
+    if(f == NULL)
+        return false;
+    fprintf(f, "# channel low_ns high_ns count\n");
+    for(int c = 0; c < TRACE_CHANNELS; c++)
+        for(int b = 0; b < HIST_BUCKETS; b++)
+            if(trace->hist[c].buckets[b] != 0)
+                fprintf(f, "%s %ld %ld %ld\n", traceNames[c], histLow(b), histLow(b + 1) - 1,
+                        trace->hist[c].buckets[b]);
+    return fclose(f) == 0;
+}
+
+#endif
@@ -2,11 +2,8 @@
 * File: blackjack_mq.cpp
 * Author: Milan Gulati
 * Procedures:
-* main          - creates message queues and forks dealer and player processes, manages the processes
-* playerOne     - player one hit/stand strategy (hit when < 15)
-* playerTwo     - player two hit/stand strategy (hit when < 18)
-* dealer        - dealer hit/stand rules (hit when < 17)
-* handValue     - computes integer value of hand vector
+* main          - parses options and runs the game locally, as an agent or as a coordinator
+* runTable      - creates message queues and forks dealer and player processes, manages the processes
 ***************************************************************************/
 
 /* Import Libraries */
@@ -14,18 +11,34 @@
 #include <sys/ipc.h>
 #include <sys/msg.h>
 #include <unistd.h>
+#include <sys/wait.h>
 #include <bits/stdc++.h>
 #include <algorithm>
 #include <iomanip>
 #include <iostream>
+#include "blackjack_options.h"
+#include "blackjack_stats.h"
+#include "blackjack_deck.h"
+#include "blackjack_shuffle.h"
+#include "blackjack_game.h"
+#include "blackjack_checkpoint.h"
+#include "blackjack_signals.h"
+#include "blackjack_dist.h"
+#include "blackjack_affinity.h"
+#include "blackjack_dealercache.h"
+#include "blackjack_results.h"
+#include "blackjack_hist.h"
 
 using namespace std;
 
 /* Function Prototypes */
-bool playerOne(int val);                    // player one strategy function
-bool playerTwo(int val);                    // player two strategy function
-bool dealer(int val);                       // dealer rules function
-int handValue(vector<char> hand);           // compute hand value function
+bool runTable(simOptions &opts, long wins[3]);  // play games on the local engine
+
+dealerCache oddsCache = {{}, {}, 0, 0, 0, handValue, dealer, {}, {}};   // exact dealer outcomes for --expected
+estimate winEstimate = {0, {0, 0, 0}, {0, 0, 0}};               // expected wins summed by the dealer
+netTally tableNet = {{0, 0}, {0, 0}};                           // hands and net units summed by the dealer
+
+latencyTrace *trace = NULL;                 // shared hit latency histograms, NULL unless --trace
 
 // message buffer for card chars
 struct cardbuff
@@ -34,119 +47,313 @@ struct cardbuff
     char card;                              // card char representation
 };
 
-// message buffer for hit/stand bool
+// message buffer for a player's decision
 struct hsbuff
 {
-    long msg_type;                          // message type (2 for bool)
-    bool hs;                                // hit or stand bool
+    long msg_type;                          // message type (2 for a decision)
+    char hs;                                // DEC_* code, DEC_STAND ends the player's turn
 };
 
-// message buffer for hand value
+// message buffer for the hands a player played
 struct handbuff
 {
-    long msg_type;                          // message type (3 for int)
-    int hand;                               // hand integer value
+    long msg_type;                          // message type (3 for hands)
+    seatResult seat;                        // final value and stake of each hand
+};
+
+/*
+* queueDeal is a player's card source for playSeat(): the decision goes to
+* the dealer's queue and the cards it takes come back one message each
+*/
+struct queueDeal
+{
+    int cardQueue;                          // id of the player's card queue
+    int decisionQueue;                      // id of the player's hit/stand queue
+    int slot;                               // TRACE_P1 or TRACE_P2
+
+    void operator()(int code, char got[2])
+    {
+        hsbuff hs = {2, (char) code};
+        cardbuff card;
+        long sent = trace != NULL ? traceClock() : 0;
+        msgsnd(decisionQueue, &hs, 1, 0);               // hit, double or split
+        for(int c = 0; c < decisionCards[code]; c++)    // and the cards it takes
+        {
+            if(msgrcv(cardQueue, &card, 1, 1, 0) == -1)
+                exit(1);                                // queue removed, dealer is gone
+            got[c] = card.card;
+        }
+        if(trace != NULL)                               // decision sent -> cards back
+            histRecord(trace->hist[slot], traceClock() - sent);
+    }
 };
 
 /***************************************************************************
 * int main()
 * Author: Milan Gulati
+* Description: Parses the command line and plays the games. By default the
+*              games are played by runTable() on this machine. With --agent
+*              the program serves shards to a coordinator instead, and with
+*              --coordinate it splits the run into shards played by agents.
+*              Displays the win stats of the dealer and players.
+*
+* Parameters:
+*   argc    I/P     int         Number of arguments on command line
+*   argv    I/P     char *[]    Arguments listed on command line
+*   main    O/P     int         Status code returns 1 on bad options, bad checkpoint or failed run
+***************************************************************************/
+int main(int argc, char *argv[])
+{
+    simOptions opts;                                    // games to play, monitoring
+    if(!parseOptions(argc, argv, opts))
+    {
+        usage(argv[0]);
+        return 1;
+    }
+
+    long wins[3] = {0, 0, 0};                           // player 1, player 2, dealer wins
+
+    /* Resume From Checkpoint */
+    // the checkpoint replaces seed, game count, rules, win counters and net tally
+    // games before nextGame are never replayed
+    if(opts.resume)
+    {
+        checkpoint ckpt;
+        if(!checkpointLoad(opts.checkpoint, ckpt) || ckpt.variant != 'M')
+        {
+            cerr << "cannot resume: " << opts.checkpoint << " is not a valid message queue checkpoint" << endl;
+            return 1;
+        }
+        opts.seed = ckpt.seed;
+        opts.games = ckpt.gamesTotal;
+        opts.first = ckpt.nextGame;
+        wins[0] = ckpt.p1Wins;
+        wins[1] = ckpt.p2Wins;
+        wins[2] = ckpt.dealerWins;
+        opts.rules = ckpt.rules;
+        tableNet.hands[0] = ckpt.p1Hands;
+        tableNet.hands[1] = ckpt.p2Hands;
+        tableNet.halves[0] = ckpt.p1Net;
+        tableNet.halves[1] = ckpt.p2Net;
+        if(!optionsValid(opts))                         // e.g. saved with --rules, resumed with --expected
+        {
+            cerr << "cannot resume: the run saved in " << opts.checkpoint << " conflicts with the options given" << endl;
+            return 1;
+        }
+    }
+
+    /* Cpu Placement */
+    if(opts.pin != NULL)
+    {
+        if(!placeTable(opts.pin, opts.cpus))
+        {
+            cerr << "cannot place processes on cpus \"" << opts.pin << "\"" << endl;
+            return 1;
+        }
+        cerr << "dealer on cpu " << opts.cpus[0] << ", player one on cpu " << opts.cpus[1]
+             << ", player two on cpu " << opts.cpus[2] << endl;
+    }
+
+    /* Pipe Transport */
+    if(opts.uring != 0)
+    {
+        cerr << "--uring batches pipe reads and writes, the message queue variant has no pipes" << endl;
+        return 1;
+    }
+
+    /* Latency Tracing */
+    // mapped before any fork() so the dealer sees what the players record
+    if(opts.trace != NULL && (trace = traceCreate()) == NULL)
+    {
+        cerr << "cannot map latency histograms" << endl;
+        return 1;
+    }
+
+    /* Play Games */
+    long played = opts.games - opts.first;              // games this process plays
+    long before[3] = {wins[0], wins[1], wins[2]};       // wins carried over from a checkpoint
+    double start = monotonicNow();                      // wall clock for the throughput line
+    if(opts.agentPort != 0)                             // serve shards, returns on a socket error
+        return runAgent(opts, runTable);
+    if(opts.agents != NULL)                             // shards played by agents
+    {
+        if(runCoordinator(opts, wins) != 0)
+            return 1;
+    }
+    else if(!runTable(opts, wins))                      // all games played here
+        return 1;
+    double elapsed = monotonicNow() - start;            // includes fork and IPC setup
+
+    long p1Wins = wins[0];
+    long p2Wins = wins[1];
+    long dealerWins = wins[2];
+
+    // all games have finished 
+    // display win stats for players and dealer
+    cout << "\nMESSAGE QUEUE IMPLEMENTATION" << endl;
+    cout << "Games:             " << opts.games << endl;
+    cout << "Seed:              " << opts.seed << endl;
+    cout << "----------------------------------------------" << endl;
+    cout << "Player One Wins:   " << p1Wins << " | Win Precentage: " << setprecision(4) << 100.0*p1Wins/opts.games << "%" << endl;
+    cout << "Player Two Wins:   " << p2Wins << " | Win Precentage: " << setprecision(4) << 100.0*p2Wins/opts.games << "%" << endl;
+    cout << "Dealer Wins:       " << dealerWins << " | Win Precentage: " << setprecision(4) << 100.0*dealerWins/opts.games << "%" << endl;
+    if(opts.rules != 0)
+        rulesReport(opts.rules, tableNet, opts.games);
+    cout << "----------------------------------------------" << endl;
+    cout << "Time:              " << setprecision(4) << elapsed << " s | Games/sec: " << (long) (played / elapsed) << endl;
+
+    if(opts.expected)
+    {
+        long counted[3] = {p1Wins - before[0], p2Wins - before[1], dealerWins - before[2]};
+        estimateReport(winEstimate, counted, oddsCache);
+    }
+
+    if(opts.results != NULL)
+    {
+        resultsValue row[RESULTS_COLS];                 // one row per run, see blackjack_results.h
+        resultsRow(row, 'M', opts, wins, played, elapsed, opts.expected ? &winEstimate : NULL, tableNet);
+        if(!resultsAppend(opts.results, row))
+        {
+            cerr << "cannot append results to " << opts.results << endl;
+            return 1;
+        }
+    }
+
+    if(trace != NULL && !traceReport(trace, opts.trace))
+    {
+        cerr << "cannot write latency histograms to " << opts.trace << endl;
+        return 1;
+    }
+
+    return 0;
+}
+
+/***************************************************************************
+* bool runTable(simOptions &opts, long wins[3])
+* Author: Milan Gulati
 * Description: Creates message queues, dealer and player processes. The dealer
 *              manages the two worker player processes. The dealer process manages
 *              players by sending cards via message queues for the initial hand,
 *              as well as in response to the player's decision to hit/stand, 
 *              which is also sent via messsage queue. The dealer recieves the value
 *              for the player's final hand through another message queue. Tracks the 
-*              wins of dealer and players.
+*              wins of dealer and players for games opts.first to opts.games - 1.
+*              Only the dealer returns; the players exit when done.
 *
 * Parameters:
-*   argc    I/P     int         Number of arguments on command line
-*   argv    I/P     char *[]    Arguments listed on command line
-*   main    O/P     int         Status code returns nothing
+*   opts        I/P     simOptions &    Seed, game range, monitoring and checkpoint settings
+*   wins        I/O     long [3]        Player 1, player 2 and dealer wins, added to
+*   runTable    O/P     bool            False on failure of msgget() or fork()
 ***************************************************************************/
-int main(int argc, char *argv[])
+bool runTable(simOptions &opts, long wins[3])
 {
     /*
     * cards[] is a character array of each possible card drawn
-    * 'A' represents Ace for a value of either 1 or 11
-    * 'T' represents 10, Jack, Queen, King for a value of 10
-    *  All other cards are at face value
+    * ringDeal() deals it from (seed, game) every game, see blackjack_shuffle.h
     */
-    char cards[] = {'2', '2', '2', '2', '3', '3', '3', '3', '4', '4', '4', '4', '5', '5', '5', '5',
-                    '6', '6', '6', '6', '7', '7', '7', '7', '8', '8', '8', '8', '9', '9', '9', '9',
-                    'T', 'T', 'T', 'T', 'T', 'T', 'T', 'T', 'T', 'T', 'T', 'T', 'T', 'T', 'T', 'T',
-                    'A', 'A', 'A', 'A'};
+    char cards[DECK_SIZE];
                     
-    int dealerWins = 0;                                 // track dealer wins
-    int p1Wins = 0;                                     // track player 1 wins
-    int p2Wins = 0;                                     // track player 2 wins
+    long dealerWins = wins[2];                          // track dealer wins
+    long p1Wins = wins[0];                              // track player 1 wins
+    long p2Wins = wins[1];                              // track player 2 wins
     int spot = 0;                                       // track "spot" in deck after sending/drawing a card
 
+    ruleTables rules;                                   // the game as lookups, inherited by the players
+    rulesBuild(rules, opts.rules);
+
     /*
     * Declare Keys
-    * ftok creates a unique key_t to be used for IPC
-    * different processes can access the same resources (message queues) given the same key_t
+    * a key_t names a message queue so that different processes can find the same queue
     * the key is used by msgget() to obtain an integer id to refer to a specific message queue
     * this id is used when sending and receiving messages from a queue
-    * key_t ftok(const char *pathname, int proj_id)
-    * pathname is the location of the source file for each key
-    * proj_id must be unique for each ftok to generate a unique key
+    * the players are forked from this process after the queues exist and inherit the ids,
+    * so no shared name is needed: IPC_PRIVATE always creates a new queue that no other
+    * run (e.g. a second agent started from the same binary) can collide with
     */
-    key_t card1 = ftok("./programtwo_mq.cpp", 66);      // identifier for cards sent to p1
-    key_t card2 = ftok("./programtwo_mq.cpp", 69);      // identifier for cards sent to p2
-    key_t hs1 = ftok("./programtwo_mq.cpp", 72);        // identifier for hit/stand sent from p1 to dealer
-    key_t hs2 = ftok("./programtwo_mq.cpp", 75);        // identifier for hit/stand sent from p2 to dealer
-    key_t hand1 = ftok("./programtwo_mq.cpp", 78);      // identifier for hand value sent from p1 to dealer
-    key_t hand2 = ftok("./programtwo_mq.cpp", 81);      // identifier for hand value sent from p2 to dealer
+    key_t card1 = IPC_PRIVATE;                          // identifier for cards sent to p1
+    key_t card2 = IPC_PRIVATE;                          // identifier for cards sent to p2
+    key_t hs1 = IPC_PRIVATE;                            // identifier for decisions sent from p1 to dealer
+    key_t hs2 = IPC_PRIVATE;                            // identifier for decisions sent from p2 to dealer
+    key_t hand1 = IPC_PRIVATE;                          // identifier for hands sent from p1 to dealer
+    key_t hand2 = IPC_PRIVATE;                          // identifier for hands sent from p2 to dealer
 
     /*
     * Set msgget()
     * msgget will provide a unique integer for each message queue
     * int msgget(key_t, int msgflg)
     * key_t used is the respecitve key above
-    * msgflg is set to 0666 | IPC_CREAT to set permissions and create new queue
+    * msgflg is set to 0600 | IPC_CREAT to set permissions and create new queue
     */
-    int id_card1 = msgget(card1, 0666 | IPC_CREAT);     // create specific message queue for card1
-    int id_card2 = msgget(card2, 0666 | IPC_CREAT);     // create specific message queue for card2
-    int id_hs1 = msgget(hs1, 0666 | IPC_CREAT);         // create specific message queue for hs1
-    int id_hs2 = msgget(hs2, 0666 | IPC_CREAT);         // create specific message queue for hs2
-    int id_hand1 = msgget(hand1, 0666 | IPC_CREAT);     // create specific message queue for hand1
-    int id_hand2 = msgget(hand2, 0666 | IPC_CREAT);     // create specific message queue for hand2
+    int id_card1 = msgget(card1, 0600 | IPC_CREAT);     // create specific message queue for card1
+    int id_card2 = msgget(card2, 0600 | IPC_CREAT);     // create specific message queue for card2
+    int id_hs1 = msgget(hs1, 0600 | IPC_CREAT);         // create specific message queue for hs1
+    int id_hs2 = msgget(hs2, 0600 | IPC_CREAT);         // create specific message queue for hs2
+    int id_hand1 = msgget(hand1, 0600 | IPC_CREAT);     // create specific message queue for hand1
+    int id_hand2 = msgget(hand2, 0600 | IPC_CREAT);     // create specific message queue for hand2
+    int queueIds[] = {id_card1, id_card2, id_hs1, id_hs2, id_hand1, id_hand2};
+
+    for(int q = 0; q < 6; q++)
+    {
+        if(queueIds[q] == -1)                           // msgget failed, remove the ones already made
+        {
+            for(int r = 0; r < q; r++)
+                msgctl(queueIds[r], IPC_RMID, NULL);
+            return false;
+        }
+    }
 
     /* First fork() */
+    pid_t dealerPid = getpid();                         // players watch this pid
     pid_t pid = fork();
 
     if(pid < 0)                                         // fork function returns negative on failure
     {
-        return 1;
+        for(int q = 0; q < 6; q++)
+            msgctl(queueIds[q], IPC_RMID, NULL);
+        return false;
     }
 
     /* Parent Dealer Process */
     else if(pid > 0)
     {
-                                                        // declare structs for sending cards, recieving hit/stand, recieving hand values
+        if(!pinSelf(opts.cpus[0]))                      // always true without --pin
+            cerr << "warning: could not pin dealer to cpu " << opts.cpus[0] << ", running unpinned" << endl;
+
+                                                        // declare structs for sending cards, recieving decisions, recieving hands
         cardbuff card_p1, card_p2;                      // cards to p1, p2
-        hsbuff hs_p1, hs_p2;                            // h/s from p1, p2
-        handbuff hand_p1, hand_p2;                      // hand from p1, p2
+        hsbuff hs_p1, hs_p2;                            // decisions from p1, p2
+        handbuff hand_p1, hand_p2;                      // hands from p1, p2
 
-        vector<char> handDealer;                        // dealer's hand vector
         int valDealer = 0;                              // value of dealer's hand
-        bool statusDealer;                              // hit/stand for dealer
 
-        for(int i = 0; i < 1000; i++)
+        // remove the queues (and stats page) if the dealer is interrupted
+        for(int q = 0; q < 6; q++)
+            cleanupQueue(queueIds[q]);
+        installCleanup();
+
+        statsPage *stats = NULL;                        // live metrics for bjstat
+        if(opts.stats)
         {
-            srand(time(0));                             // set random seed
-            random_shuffle(cards, cards + 52);          // shuffle for new iteration
-            spot = 0;                                   // top of deck
+            pid_t owner;
+            stats = statsCreate('M', "mq", opts.first, opts.games, owner);
+            if(stats == NULL && owner != 0)
+                cerr << "stats page is in use by pid " << owner << " (another run in this directory), continuing without it" << endl;
+            else if(stats == NULL)
+                cerr << "stats page unavailable, continuing without it" << endl;
+            else
+                cleanupShm(stats->shmid);
+        }
+        const char *queueNames[] = {"card1", "card2", "hs1", "hs2", "hand1", "hand2"};
 
-            handDealer.clear();                         // clear dealer's hand
+        deckRing deal;                                  // decks of the next games, dealt in batches
+        ringStart(deal, opts.seed);
+        for(long i = opts.first; i < opts.games; i++)
+        {
+            memcpy(cards, ringDeal(deal, i), DECK_SIZE); // deal the deck for game i
+            spot = 0;                                   // top of deck
 
             /* Deal Initial Hand */
-                                                        // add two cards to dealer's hand
-            handDealer.push_back(cards[spot]);          // add card to dealer hand
-            spot++;                                     // next card
-            handDealer.push_back(cards[spot]);          // add card to dealer hand
-            spot++;                                     // next card
+            spot += 2;                                  // dealer holds cards 0 and 1
 
             // send two cards to p1
             card_p1 = {1, cards[spot]};                 // place card in buffer
@@ -164,80 +371,125 @@ int main(int argc, char *argv[])
             spot++;                                     // next card
             msgsnd(id_card2, &card_p2, 1, 0);           // send card to mq
 
-            /* Hit/Stand Response */
-            // p1 sends hit or stand signal --> send card back until stand
-            // p2 sends hit or stand signal --> send card back until stand
-            bool statusP1, statusP2;                    // stores hit/stand signal from players
-            msgrcv(id_hs1, &hs_p1, 1, 2, 0);            // hit/stand from p1
-            statusP1 = hs_p1.hs;                        // copy attribute to status
-            msgrcv(id_hs2, &hs_p2, 1, 2, 0);            // hit/stand from p2
-            statusP2 = hs_p2.hs;                        // copy attribute to status
+            // the hit/stand strategies ignore the dealer's upcard,
+            // so it only costs a message when --rules needs it
+            if(opts.rules != 0)
+            {
+                card_p1 = {1, cards[0]};
+                msgsnd(id_card1, &card_p1, 1, 0);
+                card_p2 = {1, cards[0]};
+                msgsnd(id_card2, &card_p2, 1, 0);
+            }
+
+            /* Player Decisions */
+            // p1 sends a decision --> send the cards it takes until stand
+            // p2 sends a decision --> send the cards it takes until stand
+            msgrcv(id_hs1, &hs_p1, 1, 2, 0);            // first decision from p1
+            msgrcv(id_hs2, &hs_p2, 1, 2, 0);            // first decision from p2
 
             // send cards to p1 until stand
-            while(statusP1 == true)
+            while(hs_p1.hs != DEC_STAND)
             {
-                card_p1 = {1, cards[spot]};             // place card in buffer
-                spot++;                                 // next card
-                msgsnd(id_card1, &card_p1, 1, 0);       // send card to mq                
-                msgrcv(id_hs1, &hs_p1, 1, 2, 0);        // recieve updated status
-                statusP1 = hs_p1.hs;                    // update status
+                long sent = trace != NULL ? traceClock() : 0;   // stamp for --trace
+                for(int c = 0; c < decisionCards[(int) hs_p1.hs]; c++)
+                {
+                    card_p1 = {1, cards[spot]};         // place card in buffer
+                    spot++;                             // next card
+                    msgsnd(id_card1, &card_p1, 1, 0);   // send card to mq
+                }
+                msgrcv(id_hs1, &hs_p1, 1, 2, 0);        // recieve next decision
+                if(trace != NULL)
+                    histRecord(trace->hist[TRACE_DEALER_P1], traceClock() - sent);
             }
             // send cards to p2 until stand
-            while(statusP2 == true)
+            while(hs_p2.hs != DEC_STAND)
             {
-                card_p2 = {1, cards[spot]};             // place card in buffer
-                spot++;                                 // next card
-                msgsnd(id_card2, &card_p2, 1, 0);       // send card to mq                
-                msgrcv(id_hs2, &hs_p2, 1, 2, 0);        // recieve updated status
-                statusP2 = hs_p2.hs;                    // update status
+                long sent = trace != NULL ? traceClock() : 0;   // stamp for --trace
+                for(int c = 0; c < decisionCards[(int) hs_p2.hs]; c++)
+                {
+                    card_p2 = {1, cards[spot]};         // place card in buffer
+                    spot++;                             // next card
+                    msgsnd(id_card2, &card_p2, 1, 0);   // send card to mq
+                }
+                msgrcv(id_hs2, &hs_p2, 1, 2, 0);        // recieve next decision
+                if(trace != NULL)
+                    histRecord(trace->hist[TRACE_DEALER_P2], traceClock() - sent);
             }
 
+            /* Dealer Odds */
+            // what the dealer can still draw, taken before its own draws move spot
+            int unseen[RANKS];
+            if(opts.expected)
+                shoeUnseen(cards, spot, unseen);
+
             /* Dealer Draws Cards */
-            valDealer = handValue(handDealer);          // compute dealer's hand value
-            statusDealer = dealer(valDealer);           // determine dealer's status
-            while(statusDealer == true)                 // hit while status is true
-            {
-                handDealer.push_back(cards[spot]);      // add card to hand
-                spot++;
-                valDealer = handValue(handDealer);      // recompute hand value
-                statusDealer = dealer(valDealer);       // recompute status of dealer
-            }
+            valDealer = dealerPlay(rules, cards, spot); // draws from spot on
 
-            int valP1, valP2;                           // store final value of player hands
-            msgrcv(id_hand1, &hand_p1, 4, 3, 0);        // final hand val of P1
-            valP1 = hand_p1.hand;                       // store hand attribute
-            msgrcv(id_hand2, &hand_p2, 4, 3, 0);        // final hand val of P2
-            valP2 = hand_p2.hand;                       // store hand attribute
+            msgrcv(id_hand1, &hand_p1, sizeof(seatResult), 3, 0);   // hands of P1
+            msgrcv(id_hand2, &hand_p2, sizeof(seatResult), 3, 0);   // hands of P2
 
             /* Determine Wins */
-            if(valDealer > 21)  // dealer busts
+            // hand by hand, see settleSeat(); a seat wins the game when it comes out ahead
+            bool dealerWon = false;
+            long netP1 = settleSeat(hand_p1.seat, valDealer, dealerWon);
+            long netP2 = settleSeat(hand_p2.seat, valDealer, dealerWon);
+            p1Wins += netP1 > 0;
+            p2Wins += netP2 > 0;
+            dealerWins += dealerWon;
+            tableNet.hands[0] += hand_p1.seat.hands;
+            tableNet.hands[1] += hand_p2.seat.hands;
+            tableNet.halves[0] += netP1;
+            tableNet.halves[1] += netP2;
+
+            /* Expected Outcome */
+            // --expected is only allowed for the hit/stand game: one hand per seat
+            if(opts.expected)
             {
-                if(valP1 <= 21)                         // delaer busts, player1 <= 21, player1 wins
-                    p1Wins++;
-                if(valP2 <= 21)                         // dealer busts, player2 <= 21, player2 wins
-                    p2Wins++;
-                if(valP1 > 21 || valP2 > 21)            // either player busts, dealer wins
-                    dealerWins++;
+                double expect[3];
+                expectedWins(dealerOutcome(oddsCache, unseen, cards[0]), hand_p1.seat.value[0],
+                             hand_p2.seat.value[0], expect);
+                estimateAdd(winEstimate, expect);
             }
-            else    // dealer <= 21
+
+            /* Publish Live Stats */
+            if(stats != NULL)
             {
-                if(valP1 <= 21 && valP1 > valDealer)        // player1 <= 21 and player > dealer, player1 wins
-                    p1Wins++;
-                if(valP2 <= 21 && valP2 > valDealer)        // player2 <= 21 and player > dealer, player2 wins
-                    p2Wins++;
-                if(valP1 < valDealer || valP2 < valDealer)  // dealer <= 21 and player < dealer, dealer wins
-                    dealerWins++;
+                long seatWins[STATS_SEATS] = {p1Wins, p2Wins};
+                statsPublish(stats, i + 1, seatWins, dealerWins);
+                if(i % STATS_PERIOD == 0)               // msgctl is a syscall, sample sparingly
+                {
+                    long depth[STATS_QUEUES];
+                    for(int q = 0; q < 6; q++)
+                    {
+                        struct msqid_ds info;
+                        depth[q] = msgctl(queueIds[q], IPC_STAT, &info) == 0 ? (long) info.msg_cbytes : -1;
+                    }
+                    statsQueues(stats, 6, queueNames, depth);
+                }
             }
-        }     
 
-        // 1000 games have finished 
-        // display win stats for players and dealer
-        cout << "\nMESSAGE QUEUE IMPLEMENTATION" << endl;
-        cout << "Games:             1000" << endl;
-        cout << "----------------------------------------------" << endl;
-        cout << "Player One Wins:   " << p1Wins << " | Win Precentage: " << setprecision(4) << p1Wins/10.0 << "%" << endl;
-        cout << "Player Two Wins:   " << p2Wins << " | Win Precentage: " << setprecision(4) << p2Wins/10.0 << "%" << endl;
-        cout << "Dealer Wins:       " << dealerWins << " | Win Precentage: " << setprecision(4) <<dealerWins/10.0 << "%" << endl;
+            /* Save Checkpoint */
+            if(opts.checkpoint != NULL && ((i + 1) % opts.every == 0 || i + 1 == opts.games))
+            {
+                checkpoint ckpt;
+                memset(&ckpt, 0, sizeof(ckpt));         // zero padding so the checksum is stable
+                ckpt.variant = 'M';
+                ckpt.seed = opts.seed;
+                ckpt.gamesTotal = opts.games;
+                ckpt.nextGame = i + 1;
+                ckpt.p1Wins = p1Wins;
+                ckpt.p2Wins = p2Wins;
+                ckpt.dealerWins = dealerWins;
+                ckpt.rules = opts.rules;
+                ckpt.p1Hands = tableNet.hands[0];
+                ckpt.p2Hands = tableNet.hands[1];
+                ckpt.p1Net = tableNet.halves[0];
+                ckpt.p2Net = tableNet.halves[1];
+                if(!checkpointSave(opts.checkpoint, ckpt))
+                    cerr << "warning: could not write checkpoint " << opts.checkpoint << endl;
+            }
+        }
+        statsFinish(stats);                             // mark done and remove the page
 
         // end the message queues
         msgctl(id_card1, IPC_RMID, NULL);   // remove card1
@@ -246,261 +498,100 @@ int main(int argc, char *argv[])
         msgctl(id_hs2, IPC_RMID, NULL);     // remove hs2
         msgctl(id_hand1, IPC_RMID, NULL);   // remove hand1
         msgctl(id_hand2, IPC_RMID, NULL);   // remove hand2
+        cleanupClear();                     // nothing left for the signal handler
+
+        waitpid(pid, NULL, 0);              // reap player 1 (which reaps player 2)
 
-        return 0;
+        wins[0] = p1Wins;                   // hand totals back to main
+        wins[1] = p2Wins;
+        wins[2] = dealerWins;
+        return true;
     }
 
     /* Worker Player Processes */
     else
     {
+        followParent(dealerPid);                        // exit if the dealer is killed
+
         /* Second fork() */
+        pid_t p1Pid = getpid();                         // player 2 watches player 1
         pid_t pid2 = fork();
 
         if(pid2 < 0)    // fork failure
         {
-            return 1;
+            exit(1);    // never return into the dealer's code
         }
         
         /* Player 1 Process */
         else if(pid2 > 0)
         {
-            // declare structs for recieving cards, sending hit/stand, sending hand value
-            cardbuff card_p1;               // cards from dealer
-            hsbuff hs_p1;                   // hs to dealer
-            handbuff hand_p1;               // hand to dealer
-
-            vector<char> handP1;            // p1 hand vector
-            char c1, c2;                    // first two cards from dealer
-            int valP1 = 0;                  // value of hand
-            bool hitStand = false;          // hit or stand determination
-
-            // iterations must be the same amount as parent for loop (1000)
-            for(int p1 = 0; p1 < 1000; p1++)
-            {
-                handP1.clear();                             // clear hand
-                msgrcv(id_card1, &card_p1, 1, 1, 0);        // read first card
-                c1 = card_p1.card;                          // copy to c1
-                msgrcv(id_card1, &card_p1, 1, 1, 0);        // read second card
-                c2 = card_p1.card;                          // copy to c2
-
-                handP1.push_back(c1);                       // add first card to vector
-                handP1.push_back(c2);                       // add second card to vector
+            if(!pinSelf(opts.cpus[1]))
+                cerr << "warning: could not pin player one to cpu " << opts.cpus[1] << ", running unpinned" << endl;
 
-                valP1 = handValue(handP1);                  // calculate current total
+            // declare structs for recieving cards, sending the stand and hands
+            cardbuff card_p1;                           // cards from dealer
+            hsbuff hs_p1;                               // stand to dealer
+            handbuff hand_p1;                           // hands to dealer
 
-                hitStand = playerOne(valP1);                // determine hit or stand
-                hs_p1 = {2, hitStand};                      // set hit/stand buff attributes
-                msgsnd(id_hs1, &hs_p1, 1, 0);               // send initial hit/stand
+            char first[3] = {0, 0, 0};                  // first two cards and (with --rules) the upcard
+            int dealt = opts.rules != 0 ? 3 : 2;        // messages the dealer opens with
+            queueDeal deal = {id_card1, id_hs1, TRACE_P1};
 
-                while(hitStand == true)                     // while hit is true
+            // iterations must be the same amount as parent for loop (opts.games)
+            for(long p1 = opts.first; p1 < opts.games; p1++)
+            {
+                for(int c = 0; c < dealt; c++)
                 {
-                    char temp;
-                    msgrcv(id_card1, &card_p1, 1, 1, 0);    // recieve one more card
-                    temp = card_p1.card;                    // store card attribute in temp
-                    handP1.push_back(temp);                 // add temp to hand
-                    valP1 = handValue(handP1);              // recompute hand value
-                    hand_p1 = {3, valP1};                   // update hand buff
-                    hitStand = playerOne(valP1);            // redetermine status
-                    hs_p1 = {2, hitStand};                  // update hs buff
-                    msgsnd(id_hs1, &hs_p1, 1, 0);           // send hs to dealer again
+                    if(msgrcv(id_card1, &card_p1, 1, 1, 0) == -1)   // read the opening cards
+                        exit(1);                            // queue removed, dealer is gone
+                    first[c] = card_p1.card;
                 }
 
-                hand_p1 = {3, valP1};                       // update hand again before sending (in case player never hits)
-                msgsnd(id_hand1, &hand_p1, 4, 0);           // send final hand value to dealer
+                hand_p1.msg_type = 3;
+                playSeat(rules, 0, first, first[2], deal, hand_p1.seat);    // decisions go out through deal
+
+                hs_p1 = {2, DEC_STAND};                   // turn over
+                msgsnd(id_hs1, &hs_p1, 1, 0);           // send stand to dealer
+                msgsnd(id_hand1, &hand_p1, sizeof(seatResult), 0);  // send the hands to dealer
             }
+            waitpid(pid2, NULL, 0);                         // player 2 exits on SIGTERM once player 1 is gone
             exit(0);                                        // exit completed process
         }
 
         /* Player 2 Process */
         else
         {
-            // declare structs for recieving cards, sending hit/stand, sending hand value
-            cardbuff card_p2;                           // cards from dealer
-            hsbuff hs_p2;                               // hs to dealer
-            handbuff hand_p2;                           // hand to dealer
-
-            vector<char> handP2;                        // p2 hand vector
-            char c1, c2;                                // first two cards from dealer
-            int valP2 = 0;                              // value of hand
-            bool hitStand = false;                      // hit or stand determination
-
-            // iterations must be the same amount as parent for loop (1000)
-            for(int p2 = 0; p2 < 1000; p2++)
-            {
-                handP2.clear();                             // clear hand
-
-                msgrcv(id_card2, &card_p2, 1, 1, 0);        // read first card
-                c1 = card_p2.card;                          // copy to c1
-                msgrcv(id_card2, &card_p2, 1, 1, 0);        // read second card
-                c2 = card_p2.card;                          // copy to c2
-
-                handP2.push_back(c1);                       // add first card to vector
-                handP2.push_back(c2);                       // add second card to vector
-
-                valP2 = handValue(handP2);                  // calculate current total
-
-                hitStand = playerTwo(valP2);                // determine hit or stand
-                hs_p2 = {2, hitStand};                      // set hit/stand buff attributes
-                msgsnd(id_hs2, &hs_p2, 1, 0);               // send initial hit/stand
-
-                while(hitStand == true)                     // while hit is true
-                {
-                    char temp;
-                    msgrcv(id_card2, &card_p2, 1, 1, 0);    // recieve one more card
-                    temp = card_p2.card;                    // store card attribute in temp
-                    handP2.push_back(temp);                 // add temp to hand
-                    valP2 = handValue(handP2);              // recompute hand value
-                    hand_p2 = {3, valP2};                   // update hand buff
-                    hitStand = playerTwo(valP2);            // redetermine status
-                    hs_p2 = {2, hitStand};                  // update hs buff
-                    msgsnd(id_hs2, &hs_p2, 1, 0);           // send hs to dealer again
-                }
-
-                hand_p2 = {3, valP2};                       // update hand again before sending (in case player never hits)
-                msgsnd(id_hand2, &hand_p2, 4, 0);           // send final hand value to dealer
-            }
-            exit(0);                                        // exit completed process
-        }
-    }
-}
-
-/***************************************************************************
-* int playerOne(int val)
-* Author: Milan Gulati
-* Description: Player one's hit/stand strategy. Hits when less than 15.
-*              Stands when greater than equal to 15.
-*              Hit returns true. Stand returns false.
-*
-* Parameters:
-*   val         I/P     int     Integer value of current hand  
-*   playerOne   O/P     bool    Hit or stand signal for player one process
-***************************************************************************/
-bool playerOne(int val)
-{
-    if(val < 15)    // hit if hand < 15
-        return true;
-    return false;   // stand otherwise
-}
+            followParent(p1Pid);                        // exit if player 1 is killed
+            if(!pinSelf(opts.cpus[2]))
+                cerr << "warning: could not pin player two to cpu " << opts.cpus[2] << ", running unpinned" << endl;
 
-/***************************************************************************
-* int playerTwo(int val)
-* Author: Milan Gulati
-* Description: Player two's hit/stand strategy. Hits when less than 18.
-*              Stands when greater than equal to 18.
-*              Hit returns true. Stand returns false.
-*
-* Parameters:
-*   val         I/P     int     Integer value of current hand  
-*   playerTwo   O/P     bool    Hit or stand signal for player two process
-***************************************************************************/
-bool playerTwo(int val)
-{
-    if(val < 18)    // hit if hand < 18
-        return true;
-    return false;   // stand otherwise
-}
-
-/***************************************************************************
-* int dealer(int val)
-* Author: Milan Gulati
-* Description: Dealer's hit/stand rule. Hits when less than 17.
-*              Stands when greater than equal to 17.
-*              Hit returns true. Stand returns false.
-*
-* Parameters:
-*   val         I/P     int     Integer value of current hand  
-*   dealer      O/P     bool    Hit or stand signal for dealer process
-***************************************************************************/
-bool dealer(int val)
-{
-    if(val < 17)    // hit if hand < 17
-        return true;
-    return false;   // stand otherwise
-}
+            // declare structs for recieving cards, sending the stand and hands
+            cardbuff card_p2;                           // cards from dealer
+            hsbuff hs_p2;                               // stand to dealer
+            handbuff hand_p2;                           // hands to dealer
 
-/***************************************************************************
-* int handValue(vector<char> hand)
-* Author: Milan Gulati
-* Description: Computes the integer value of the hand vector argument.
-*              Aces are treated specially and are dependent on the value of the
-*              other cards in the hand, and how many other aces are in the hand.
-*
-* Parameters:
-*   hand        I/P     vector<char>    Vector of chars containing cards in current hand 
-*   handValue   O/P     int             Integer value of hand computed from vector hand
-***************************************************************************/
-int handValue(vector<char> hand)
-{
-    int sum = 0;    // running sum of hand
-    int aces = count(hand.begin(), hand.end(), 'A');    // occurences of 'A' in vector
+            char first[3] = {0, 0, 0};                  // first two cards and (with --rules) the upcard
+            int dealt = opts.rules != 0 ? 3 : 2;        // messages the dealer opens with
+            queueDeal deal = {id_card2, id_hs2, TRACE_P2};
 
-    // if aces exist in hand
-    if(aces > 0)
-    {
-        // iterate through hand and sum non-ace values
-        for(auto c: hand)
-        {
-            if(c != 'A')                // card must not be an ace
+            // iterations must be the same amount as parent for loop (opts.games)
+            for(long p2 = opts.first; p2 < opts.games; p2++)
             {
-                if(c == 'T')            // 'T' equivalent to 10,J,Q,K
-                    sum += 10;          // add to sum
-                else                    // treat all other cards as face value
+                for(int c = 0; c < dealt; c++)
                 {
-                    int val = c - '0';  // convert char to int
-                    sum += val;         // add to sum
+                    if(msgrcv(id_card2, &card_p2, 1, 1, 0) == -1)   // read the opening cards
+                        exit(1);                            // queue removed, dealer is gone
+                    first[c] = card_p2.card;
                 }
-            }
-        }
 
-        // remaining cards are aces
-        // depending on how many aces are present
-        // the values will be treated as 1 for each ace accordingly
-        switch (aces)
-        {
-        case 1: /* One Ace: 1 or 11 */
-            if(sum <= 10)               // if existing sum is able to fit 11 (blackjack if sum = 10!)
-                sum += 11;
-            else                        // else treat aces as 1
-                sum += 1;
-            break;
-        case 2: /* Two Ace: 2 or 12 */
-            if(sum <= 9)                // existing sum able to fit 12 (11, 1)
-                sum += 12;
-            else                        // else treat aces as 1 (1, 1)
-                sum += 2;
-            break;
-        case 3: /* Three Ace: 3 or 13 */
-            if(sum <= 8)                // existing sum able to fit 13 (11, 1, 1)
-                sum += 13;
-            else                        // else treat aces as 1 (1, 1, 1)
-                sum += 3;
-            break;
-        case 4: /* Four Ace: 4 or 14 */
-            if(sum <= 7)                // existing sum able to fit 14 (11, 1, 1, 1)
-                sum += 14;
-            else                        // else treat aces as 1 (1, 1, 1, 1)
-                sum += 4;
-            break;
-        default:                        // default case will not occur
-            break;
-        }
-    }
+                hand_p2.msg_type = 3;
+                playSeat(rules, 1, first, first[2], deal, hand_p2.seat);    // decisions go out through deal
 
-    // else no aces exist in hand
-    else 
-    {
-        // iterate though hand and sum up every value
-        // no need to account for aces in this case
-        for(auto c: hand)
-        {
-            if(c == 'T')                // 'T' equivalent to 10,J,Q,K
-                sum += 10;              // add to sum
-            else                        // treat all other cards as face value
-            {
-                int val = c - '0';      // convert char to int
-                sum += val;             // add to sum
+                hs_p2 = {2, DEC_STAND};                   // turn over
+                msgsnd(id_hs2, &hs_p2, 1, 0);           // send stand to dealer
+                msgsnd(id_hand2, &hand_p2, sizeof(seatResult), 0);  // send the hands to dealer
             }
+            exit(0);                                        // exit completed process
         }
     }
-    return sum;                         // return sum of hand
 }
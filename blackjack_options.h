@@ -0,0 +1,254 @@
+/***************************************************************************
+* File: blackjack_options.h
+* Author: Milan Gulati
+* Procedures:
+* usage         - prints the command line options shared by every variant
+* optionsValid  - checks that the chosen options can be combined
+* parseOptions  - fills a simOptions struct from the command line
+***************************************************************************/
+
+#ifndef BLACKJACK_OPTIONS_H
+#define BLACKJACK_OPTIONS_H
+
+/* Import Libraries */
+#include <getopt.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <iostream>
+#include "blackjack_game.h"
+
+#define SHARD_MAX_GAMES 1000000000L         // largest shard an agent accepts
+
+// run configuration shared by the dealer and player processes
+// (parsed before fork() so every process sees the same values)
+struct simOptions
+{
+    long games;                             // number of games to simulate
+    long first;                             // first game to play (non zero when resuming)
+    unsigned long seed;                     // seed the decks of every game are dealt from
+    bool stats;                             // publish live stats page for bjstat
+    const char *checkpoint;                 // checkpoint file, NULL for none
+    long every;                             // games between checkpoints
+    bool resume;                            // continue from the checkpoint file
+    int agentPort;                          // agent mode: TCP port to serve shards on, 0 if off
+    const char *bind;                       // agent mode: IPv4 address to listen on
+    const char *agents;                     // coordinator mode: host:port list, NULL if off
+    long shard;                             // coordinator mode: games per shard
+    long timeout;                           // coordinator mode: seconds an agent may spend on one shard
+    const char *pin;                        // cpu placement: "auto", "D,P1,P2" or NULL
+    int cpus[3];                            // cpus for dealer, player 1, player 2 (-1 unpinned)
+    const char *trace;                      // raw latency histogram file, NULL if not tracing
+    bool expected;                          // also estimate wins from the dealer's exact odds
+    int uring;                              // pipe variant: 0 plain calls, 1 io_uring, 2 io_uring + SQPOLL
+    const char *results;                    // columnar results file to append a row to, NULL for none
+    int rules;                              // RULE_* bits on top of hit/stand, 0 for the original game
+};
+
+/***************************************************************************
+* void usage(const char *prog)
+* Author: Milan Gulati
+* Description: Prints the command line options to stderr.
+*
+* Parameters:
+*   prog    I/P     const char *    Name of the program (argv[0])
+***************************************************************************/
+inline void usage(const char *prog)
+{
+    std::cerr << "usage: " << prog << " [options]" << std::endl;
+    std::cerr << "  -n, --games N     number of games to play (default 1000)" << std::endl;
+    std::cerr << "  -S, --seed N      seed for dealing (default: current time)" << std::endl;
+    std::cerr << "  -s, --stats       publish live stats for bjstat" << std::endl;
+    std::cerr << "  -c, --checkpoint FILE" << std::endl;
+    std::cerr << "                    save progress to FILE periodically" << std::endl;
+    std::cerr << "  -k, --every N     games between checkpoints (default 100000)" << std::endl;
+    std::cerr << "  -r, --resume      continue the run saved in the checkpoint FILE" << std::endl;
+    std::cerr << "  -A, --agent PORT  serve shards to a coordinator on PORT" << std::endl;
+    std::cerr << "  -B, --bind ADDR   agent address to listen on (default 127.0.0.1)" << std::endl;
+    std::cerr << "  -C, --coordinate HOST:PORT[,HOST:PORT...]" << std::endl;
+    std::cerr << "                    split the run into shards played by these agents" << std::endl;
+    std::cerr << "  -z, --shard N     games per shard (default 100000)" << std::endl;
+    std::cerr << "  -T, --timeout N   seconds an agent may take per shard before its shard" << std::endl;
+    std::cerr << "                    is reassigned (default 600)" << std::endl;
+    std::cerr << "  -p, --pin auto|D,P1,P2" << std::endl;
+    std::cerr << "                    pin dealer and players to cpus (auto reads the topology)" << std::endl;
+    std::cerr << "  -t, --trace FILE  time every hit round trip, print percentiles and" << std::endl;
+    std::cerr << "                    write the raw histogram buckets to FILE" << std::endl;
+    std::cerr << "  -e, --expected    also report win rates averaged over the dealer's" << std::endl;
+    std::cerr << "                    unseen cards (lower variance than counting wins)" << std::endl;
+    std::cerr << "  -u, --uring on|sqpoll|off" << std::endl;
+    std::cerr << "                    pipe variant: batch pipe I/O through io_uring" << std::endl;
+    std::cerr << "  -o, --results FILE" << std::endl;
+    std::cerr << "                    append this run to a columnar results file (see bjresults)" << std::endl;
+    std::cerr << "  -R, --rules LIST  play with h17, double, split, surrender (comma separated," << std::endl;
+    std::cerr << "                    or all) and report each player's net units" << std::endl;
+    std::cerr << "  -h, --help        show this message" << std::endl;
+}
+
+/***************************************************************************
+* bool optionsValid(const simOptions &opts)
+* Author: Milan Gulati
+* Description: Rejects options that cannot be combined. Called by
+*              parseOptions, and again once a resumed run has taken its
+*              seed, range and rules from the checkpoint.
+*
+* Parameters:
+*   opts            I/P     const simOptions &  Run configuration
+*   optionsValid    O/P     bool                False if two options conflict
+***************************************************************************/
+inline bool optionsValid(const simOptions &opts)
+{
+    if(opts.resume && opts.checkpoint == NULL)          // --resume needs a file
+        return false;
+    if(opts.agents != NULL && opts.agentPort != 0)
+        return false;                                   // coordinator and agent are separate processes
+    if(opts.checkpoint != NULL && (opts.agents != NULL || opts.agentPort != 0))
+        return false;                                   // shards are not checkpointed, a shard is simply replayed
+    if((opts.trace != NULL || opts.expected) && (opts.agents != NULL || opts.agentPort != 0))
+        return false;                                   // only games played here are traced or estimated
+    if(opts.results != NULL && opts.agentPort != 0)
+        return false;                                   // the coordinator records the run, not its agents
+    if(opts.rules != 0 && (opts.expected || opts.agents != NULL || opts.agentPort != 0))
+        return false;                                   // dealer odds and shards assume the hit/stand game
+    return true;
+}
+
+/***************************************************************************
+* bool parseOptions(int argc, char *argv[], simOptions &opts)
+* Author: Milan Gulati
+* Description: Parses the command line into opts. Options that are not given
+*              keep their default value.
+*
+* Parameters:
+*   argc            I/P     int             Number of arguments on command line
+*   argv            I/P     char *[]        Arguments listed on command line
+*   opts            O/P     simOptions &    Parsed run configuration
+*   parseOptions    O/P     bool            False if the command line is invalid
+***************************************************************************/
+inline bool parseOptions(int argc, char *argv[], simOptions &opts)
+{
+    static const struct option longOpts[] = {
+        {"games",      required_argument, NULL, 'n'},
+        {"seed",       required_argument, NULL, 'S'},
+        {"stats",      no_argument,       NULL, 's'},
+        {"checkpoint", required_argument, NULL, 'c'},
+        {"every",      required_argument, NULL, 'k'},
+        {"resume",     no_argument,       NULL, 'r'},
+        {"agent",      required_argument, NULL, 'A'},
+        {"bind",       required_argument, NULL, 'B'},
+        {"coordinate", required_argument, NULL, 'C'},
+        {"shard",      required_argument, NULL, 'z'},
+        {"timeout",    required_argument, NULL, 'T'},
+        {"pin",        required_argument, NULL, 'p'},
+        {"trace",      required_argument, NULL, 't'},
+        {"expected",   no_argument,       NULL, 'e'},
+        {"uring",      required_argument, NULL, 'u'},
+        {"results",    required_argument, NULL, 'o'},
+        {"rules",      required_argument, NULL, 'R'},
+        {"help",       no_argument,       NULL, 'h'},
+        {NULL,         0,                 NULL, 0}
+    };
+
+    opts.games = 1000;                      // default matches the original 1000 games
+    opts.first = 0;
+    opts.seed = time(0);                    // different deals every run unless --seed is given
+    opts.stats = false;
+    opts.checkpoint = NULL;
+    opts.every = 100000;
+    opts.resume = false;
+    opts.agentPort = 0;
+    opts.bind = "127.0.0.1";                // only local coordinators unless asked otherwise
+    opts.agents = NULL;
+    opts.shard = 100000;
+    opts.timeout = 600;
+    opts.pin = NULL;
+    opts.cpus[0] = opts.cpus[1] = opts.cpus[2] = -1;
+    opts.trace = NULL;
+    opts.expected = false;
+    opts.uring = 0;
+    opts.results = NULL;
+    opts.rules = 0;
+
+    int c;
+    while((c = getopt_long(argc, argv, "n:S:sc:k:rA:B:C:z:T:p:t:eu:o:R:h", longOpts, NULL)) != -1)
+    {
+        switch(c)
+        {
+        case 'n':
+            opts.games = atol(optarg);
+            if(opts.games <= 0)             // need at least one game
+                return false;
+            break;
+        case 'S':
+            opts.seed = strtoul(optarg, NULL, 0);
+            break;
+        case 's':
+            opts.stats = true;
+            break;
+        case 'c':
+            opts.checkpoint = optarg;
+            break;
+        case 'k':
+            opts.every = atol(optarg);
+            if(opts.every <= 0)
+                return false;
+            break;
+        case 'r':
+            opts.resume = true;
+            break;
+        case 'A':
+            opts.agentPort = atoi(optarg);
+            if(opts.agentPort <= 0 || opts.agentPort > 65535)
+                return false;
+            break;
+        case 'B':
+            opts.bind = optarg;
+            break;
+        case 'C':
+            opts.agents = optarg;
+            break;
+        case 'z':
+            opts.shard = atol(optarg);
+            if(opts.shard <= 0 || opts.shard > SHARD_MAX_GAMES)
+                return false;
+            break;
+        case 'T':
+            opts.timeout = atol(optarg);
+            if(opts.timeout <= 0)
+                return false;
+            break;
+        case 'p':
+            opts.pin = optarg;
+            break;
+        case 't':
+            opts.trace = optarg;
+            break;
+        case 'e':
+            opts.expected = true;
+            break;
+        case 'u':
+            if(strcmp(optarg, "off") == 0)
+                opts.uring = 0;
+            else if(strcmp(optarg, "on") == 0)
+                opts.uring = 1;
+            else if(strcmp(optarg, "sqpoll") == 0)
+                opts.uring = 2;
+            else
+                return false;
+            break;
+        case 'o':
+            opts.results = optarg;
+            break;
+        case 'R':
+            opts.rules = rulesParse(optarg);
+            if(opts.rules == -1)
+                return false;
+            break;
+        default:                            // -h or unknown option
+            return false;
+        }
+    }
+    return optionsValid(opts);
+}
+
+#endif
@@ -2,11 +2,8 @@
 * File: blackjack_pipes.cpp
 * Author: Milan Gulati
 * Procedures:
-* main          - creates pipes and forks dealer and player processes, manages the processes
-* playerOne     - player one hit/stand strategy (hit when < 15)
-* playerTwo     - player two hit/stand strategy (hit when < 18)
-* dealer        - dealer hit/stand rules (hit when < 17)
-* handValue     - computes integer value of hand vector
+* main          - parses options and runs the game locally, as an agent or as a coordinator
+* runTable      - creates pipes and forks dealer and player processes, manages the processes
 ***************************************************************************/
 
 /* Import Libraries */
@@ -15,280 +12,538 @@
 #include <iomanip>
 #include <bits/stdc++.h>
 #include <unistd.h>
+#include <sys/wait.h>
+#include <sys/ioctl.h>
+#include "blackjack_options.h"
+#include "blackjack_stats.h"
+#include "blackjack_deck.h"
+#include "blackjack_shuffle.h"
+#include "blackjack_game.h"
+#include "blackjack_checkpoint.h"
+#include "blackjack_signals.h"
+#include "blackjack_dist.h"
+#include "blackjack_affinity.h"
+#include "blackjack_dealercache.h"
+#include "blackjack_results.h"
+#include "blackjack_uring.h"
+#include "blackjack_hist.h"
 
 using namespace std;
 
 /* Function Prototypes */
-bool playerOne(int val);        // player one strategy function
-bool playerTwo(int val);        // player two strategy function
-bool dealer(int val);           // dealer rules function
-int handValue(vector<char> hand);   // compute hand value function
+bool runTable(simOptions &opts, long wins[3]);  // play games on the local engine
+
+dealerCache oddsCache = {{}, {}, 0, 0, 0, handValue, dealer, {}, {}};   // exact dealer outcomes for --expected
+estimate winEstimate = {0, {0, 0, 0}, {0, 0, 0}};               // expected wins summed by the dealer
+netTally tableNet = {{0, 0}, {0, 0}};                           // hands and net units summed by the dealer
+
+latencyTrace *trace = NULL;                 // shared hit latency histograms, NULL unless --trace
+
+/*
+* pipeDeal is a player's card source for playSeat(): the decision goes to
+* the dealer and the cards it takes come back, in one batch
+*/
+struct pipeDeal
+{
+    pipeIO *io;                             // the player's transport
+    int cardFd;                             // reading end of the player's card pipe
+    int decisionFd;                         // writing end of the player's decision pipe
+    int slot;                               // TRACE_P1 or TRACE_P2
+
+    void operator()(int code, char got[2])
+    {
+        char decision = code;
+        long sent = trace != NULL ? traceClock() : 0;
+        ioWrite(*io, decisionFd, &decision, 1);         // hit, double or split
+        ioRead(*io, cardFd, got, decisionCards[code]);  // and the cards it takes
+        if(!ioFlush(*io))
+            exit(1);                                    // pipe closed, dealer is gone
+        if(trace != NULL)                               // decision sent -> cards back
+            histRecord(trace->hist[slot], traceClock() - sent);
+    }
+};
 
 /***************************************************************************
 * int main()
 * Author: Milan Gulati
-* Description: Creates pipes, dealer and player processes. The dealer (manager) process
-*              and two player (worker) processes are managed in the main method.
-*              The dealer process manages the players by sending them cards via pipes 
-*              based on their response to their hand. Tracks the wins of the dealer and 
-*              players.
+* Description: Parses the command line and plays the games. By default the
+*              games are played by runTable() on this machine. With --agent
+*              the program serves shards to a coordinator instead, and with
+*              --coordinate it splits the run into shards played by agents.
+*              Displays the win stats of the dealer and players.
 *
 * Parameters:
 *   argc    I/P     int         Number of arguments on command line
 *   argv    I/P     char *[]    Arguments listed on command line
-*   main    O/P     int         Status code returns 1 on failure of fork() or pipe() system calls
+*   main    O/P     int         Status code returns 1 on bad options, bad checkpoint or failed run
 ***************************************************************************/
 int main(int argc, char *argv[])
+{
+    simOptions opts;    // games to play, monitoring
+    if(!parseOptions(argc, argv, opts))
+    {
+        usage(argv[0]);
+        return 1;
+    }
+
+    long wins[3] = {0, 0, 0};   // player 1, player 2, dealer wins
+
+    /* Resume From Checkpoint */
+    // the checkpoint replaces seed, game count, rules, win counters and net tally
+    // games before nextGame are never replayed
+    if(opts.resume)
+    {
+        checkpoint ckpt;
+        if(!checkpointLoad(opts.checkpoint, ckpt) || ckpt.variant != 'P')
+        {
+            cerr << "cannot resume: " << opts.checkpoint << " is not a valid pipe checkpoint" << endl;
+            return 1;
+        }
+        opts.seed = ckpt.seed;
+        opts.games = ckpt.gamesTotal;
+        opts.first = ckpt.nextGame;
+        wins[0] = ckpt.p1Wins;
+        wins[1] = ckpt.p2Wins;
+        wins[2] = ckpt.dealerWins;
+        opts.rules = ckpt.rules;
+        tableNet.hands[0] = ckpt.p1Hands;
+        tableNet.hands[1] = ckpt.p2Hands;
+        tableNet.halves[0] = ckpt.p1Net;
+        tableNet.halves[1] = ckpt.p2Net;
+        if(!optionsValid(opts))             // e.g. saved with --rules, resumed with --expected
+        {
+            cerr << "cannot resume: the run saved in " << opts.checkpoint << " conflicts with the options given" << endl;
+            return 1;
+        }
+    }
+
+    /* Cpu Placement */
+    if(opts.pin != NULL)
+    {
+        if(!placeTable(opts.pin, opts.cpus))
+        {
+            cerr << "cannot place processes on cpus \"" << opts.pin << "\"" << endl;
+            return 1;
+        }
+        cerr << "dealer on cpu " << opts.cpus[0] << ", player one on cpu " << opts.cpus[1]
+             << ", player two on cpu " << opts.cpus[2] << endl;
+    }
+
+    /* Pipe Transport */
+    // fall back quietly to what the kernel allows, but say so
+    if(opts.uring != URING_OFF)
+    {
+        int mode = uringProbe(opts.uring);
+        if(mode == URING_OFF)
+            cerr << "io_uring unavailable, using plain pipe reads and writes" << endl;
+        else if(mode != opts.uring)
+            cerr << "io_uring SQPOLL unavailable or no spare cpu, submitting with io_uring_enter" << endl;
+        opts.uring = mode;
+    }
+
+    /* Latency Tracing */
+    // mapped before any fork() so the dealer sees what the players record
+    if(opts.trace != NULL && (trace = traceCreate()) == NULL)
+    {
+        cerr << "cannot map latency histograms" << endl;
+        return 1;
+    }
+
+    /* Play Games */
+    long played = opts.games - opts.first;  // games this process plays
+    long before[3] = {wins[0], wins[1], wins[2]}; // wins carried over from a checkpoint
+    double start = monotonicNow();          // wall clock for the throughput line
+    if(opts.agentPort != 0)                 // serve shards, returns on a socket error
+        return runAgent(opts, runTable);
+    if(opts.agents != NULL)                 // shards played by agents
+    {
+        if(runCoordinator(opts, wins) != 0)
+            return 1;
+    }
+    else if(!runTable(opts, wins))          // all games played here
+        return 1;
+    double elapsed = monotonicNow() - start; // includes fork and IPC setup
+
+    long p1Wins = wins[0];
+    long p2Wins = wins[1];
+    long dealerWins = wins[2];
+
+    // all games have finished 
+    // display win stats for players and dealer
+    cout << "\nPIPE IMPLEMENTATION" << endl;
+    cout << "Games:             " << opts.games << endl;
+    cout << "Seed:              " << opts.seed << endl;
+    cout << "----------------------------------------------" << endl;
+    cout << "Player One Wins:   " << p1Wins << " | Win Precentage: " << setprecision(4) << 100.0*p1Wins/opts.games << "%" << endl;
+    cout << "Player Two Wins:   " << p2Wins << " | Win Precentage: " << setprecision(4) << 100.0*p2Wins/opts.games << "%" << endl;
+    cout << "Dealer Wins:       " << dealerWins << " | Win Precentage: " << setprecision(4) << 100.0*dealerWins/opts.games << "%" << endl;
+    if(opts.rules != 0)
+        rulesReport(opts.rules, tableNet, opts.games);
+    cout << "----------------------------------------------" << endl;
+    cout << "Time:              " << setprecision(4) << elapsed << " s | Games/sec: " << (long) (played / elapsed) << endl;
+
+    if(opts.expected)
+    {
+        long counted[3] = {p1Wins - before[0], p2Wins - before[1], dealerWins - before[2]};
+        estimateReport(winEstimate, counted, oddsCache);
+    }
+
+    if(opts.results != NULL)
+    {
+        resultsValue row[RESULTS_COLS];                 // one row per run, see blackjack_results.h
+        resultsRow(row, 'P', opts, wins, played, elapsed, opts.expected ? &winEstimate : NULL, tableNet);
+        if(!resultsAppend(opts.results, row))
+        {
+            cerr << "cannot append results to " << opts.results << endl;
+            return 1;
+        }
+    }
+
+    if(trace != NULL && !traceReport(trace, opts.trace))
+    {
+        cerr << "cannot write latency histograms to " << opts.trace << endl;
+        return 1;
+    }
+
+    return 0;
+}
+
+/***************************************************************************
+* bool runTable(simOptions &opts, long wins[3])
+* Author: Milan Gulati
+* Description: Creates pipes, dealer and player processes. The dealer (manager) process
+*              and two player (worker) processes are managed in this function.
+*              The dealer process manages the players by sending them cards via pipes 
+*              based on their response to their hand: each hit, double or split
+*              is answered with the cards it takes until the player stands.
+*              Tracks the wins of the dealer and players for games opts.first
+*              to opts.games - 1. Only the dealer
+*              returns; the players exit when done.
+*
+* Parameters:
+*   opts        I/P     simOptions &    Seed, game range, monitoring and checkpoint settings
+*   wins        I/O     long [3]        Player 1, player 2 and dealer wins, added to
+*   runTable    O/P     bool            False on failure of fork() or pipe() system calls
+***************************************************************************/
+bool runTable(simOptions &opts, long wins[3])
 {
     /*
     * cards[] is a character array of each possible card drawn
-    * 'A' represents Ace for a value of either 1 or 11
-    * 'T' represents 10, Jack, Queen, King for a value of 10
-    *  All other cards are at face value
+    * ringDeal() deals it from (seed, game) every game, see blackjack_shuffle.h
     */
-    char cards[] = {'2', '2', '2', '2', '3', '3', '3', '3', '4', '4', '4', '4', '5', '5', '5', '5',
-                    '6', '6', '6', '6', '7', '7', '7', '7', '8', '8', '8', '8', '9', '9', '9', '9',
-                    'T', 'T', 'T', 'T', 'T', 'T', 'T', 'T', 'T', 'T', 'T', 'T', 'T', 'T', 'T', 'T',
-                    'A', 'A', 'A', 'A'};
+    char cards[DECK_SIZE];
 
-    int dealerWins = 0; // track dealer wins
-    int p1Wins = 0;     // track player 1 wins
-    int p2Wins = 0;     // track player 2 wins
-    int spot = 0;       // track "spot" in deck after sending/drawing a card
+    long dealerWins = wins[2];  // track dealer wins
+    long p1Wins = wins[0];      // track player 1 wins
+    long p2Wins = wins[1];      // track player 2 wins
+    int spot = 0;               // track "spot" in deck after sending/drawing a card
 
     /* Declare File Descriptors */
     int fd_cards_p1[2]; // pipe to send cards to player 1
     int fd_cards_p2[2]; // pipe to send cards to player 2
-    int fd_hs_p1[2];    // pipe to receive hit/stand from player 1
-    int fd_hs_p2[2];    // pipe to receive hit/stand from player 2
+    int fd_hs_p1[2];    // pipe to receive decisions from player 1
+    int fd_hs_p2[2];    // pipe to receive decisions from player 2
+
+    ruleTables rules;   // the game as lookups, inherited by the players
+    rulesBuild(rules, opts.rules);
 
     /* Open Pipes */
     // pipe function returns -1 on failure
     if(pipe(fd_cards_p1) == -1){
-        return 1;
+        return false;
     }
     if(pipe(fd_cards_p2) == -1){
-        return 1;
+        return false;
     }
     if(pipe(fd_hs_p1) == -1){
-        return 1;
+        return false;
     }
     if(pipe(fd_hs_p2) == -1){
-        return 1;
+        return false;
     }       
     
     /* First fork() */
+    pid_t dealerPid = getpid();     // players watch this pid
     pid_t pid = fork();
 
     if(pid < 0) // fork function returns negative on failure
     {
-        return 1;
+        return false;
     }
 
     /* Parent Dealer Process */
     else if(pid > 0)
     {
+        if(!pinSelf(opts.cpus[0]))                          // always true without --pin
+            cerr << "warning: could not pin dealer to cpu " << opts.cpus[0] << ", running unpinned" << endl;
+
         close(fd_cards_p1[0]);                              // close reading end of card pipe for p1
         close(fd_cards_p2[0]);                              // close reading end of card pipe for p2
         close(fd_hs_p1[1]);                                 // close writing end of h/s pipe for p1
         close(fd_hs_p2[1]);                                 // close writing end of h/s pipe for p2
 
-        vector<char> handDealer;                            // dealer's hand vector
         int valDealer = 0;                                  // value of dealer's hand
-        bool statusDealer;                                  // hit/stand for dealer
+        bool ok = true;                                     // false once a player is gone
+
+        pipeIO io;                                          // plain calls or io_uring, see --uring
+        ioOpen(io, opts.uring);
 
-        for(int i = 0; i < 1000; i++)
+        installCleanup();                                   // remove the stats page if interrupted
+
+        statsPage *stats = NULL;                            // live metrics for bjstat
+        if(opts.stats)
         {
-            srand(time(0));                                 // set random seed
-            random_shuffle(cards, cards + 52);              // shuffle for new iteration
-            spot = 0;                                       // top of deck
+            pid_t owner;
+            stats = statsCreate('P', "pipes", opts.first, opts.games, owner);
+            if(stats == NULL && owner != 0)
+                cerr << "stats page is in use by pid " << owner << " (another run in this directory), continuing without it" << endl;
+            else if(stats == NULL)
+                cerr << "stats page unavailable, continuing without it" << endl;
+            else
+                cleanupShm(stats->shmid);
+        }
+        int pipeFds[] = {fd_cards_p1[1], fd_cards_p2[1], fd_hs_p1[0], fd_hs_p2[0]};
+        const char *pipeNames[] = {"cards1", "cards2", "hs1", "hs2"};
 
-            handDealer.clear();                             // clear dealer's hand
+        deckRing deal;                                      // decks of the next games, dealt in batches
+        ringStart(deal, opts.seed);
+        for(long i = opts.first; i < opts.games; i++)
+        {
+            memcpy(cards, ringDeal(deal, i), DECK_SIZE);    // deal the deck for game i
+            spot = 6;                                       // first card after the initial hands
 
             /* Deal Initial Hand */
-            // add two cards to dealer's hand
-            handDealer.push_back(cards[spot]);              // add card to dealer hand
-            spot++;                                         // next card
-            handDealer.push_back(cards[spot]);              // add card to dealer hand
-            spot++;                                         // next card
-            // send two cards to p1
-            write(fd_cards_p1[1], &cards[spot], 1);         // send card to p1
-            spot++;                                         // next card
-            write(fd_cards_p1[1], &cards[spot], 1);         // send card to p1
-            spot++;                                         // next card
-            // send two cards to p2
-            write(fd_cards_p2[1], &cards[spot], 1);         // send card to p2
-            spot++;                                         // next card
-            write(fd_cards_p2[1], &cards[spot], 1);         // send card to p2
-            spot++;                                         // next card
-
-            /* Hit/Stand Response */
-            // p1 sends hit or stand signal --> send card back until stand
-            // p2 sends hit or stand signal --> send card back until stand
-            bool statusP1, statusP2;                        // stores hit/stand signal from players
-            read(fd_hs_p1[0], &statusP1, 1);                // hit/stand signal from p1
-            read(fd_hs_p2[0], &statusP2, 1);                // hit/stand signal from p2
+            // the dealer holds cards 0 and 1; each player gets its two cards
+            // and the dealer's upcard in one write
+            char dealP1[3] = {cards[2], cards[3], cards[0]};
+            char dealP2[3] = {cards[4], cards[5], cards[0]};
+            ioWrite(io, fd_cards_p1[1], dealP1, 3);         // send cards to p1
+            ioWrite(io, fd_cards_p2[1], dealP2, 3);         // send cards to p2
+
+            /* Player Decisions */
+            // p1 sends a decision --> send the cards it takes until stand
+            // p2 sends a decision --> send the cards it takes until stand
+            char codeP1, codeP2;                            // DEC_* from the players
+            ioRead(io, fd_hs_p1[0], &codeP1, 1);            // first decision from p1
+            ioRead(io, fd_hs_p2[0], &codeP2, 1);            // first decision from p2
+            ok = ioFlush(io);                               // the whole deal is one batch
 
             // send cards to p1 until stand
-            while(statusP1 == true)
+            while(ok && codeP1 != DEC_STAND)
             {
-                write(fd_cards_p1[1], &cards[spot], 1);     //send card
-                spot++;
-                read(fd_hs_p1[0], &statusP1, 1);            // recieve updated status
+                long sent = trace != NULL ? traceClock() : 0;   // stamp for --trace
+                ioWrite(io, fd_cards_p1[1], &cards[spot], decisionCards[(int) codeP1]);
+                spot += decisionCards[(int) codeP1];
+                ioRead(io, fd_hs_p1[0], &codeP1, 1);        // recieve next decision
+                ok = ioFlush(io);
+                if(trace != NULL)
+                    histRecord(trace->hist[TRACE_DEALER_P1], traceClock() - sent);
             }
             // send cards to p2 until stand
-            while(statusP2 == true)
+            while(ok && codeP2 != DEC_STAND)
             {
-                write(fd_cards_p2[1], &cards[spot], 1);     //send card
-                spot++;
-                read(fd_hs_p2[0], &statusP2, 1);            // recieve updated status
+                long sent = trace != NULL ? traceClock() : 0;   // stamp for --trace
+                ioWrite(io, fd_cards_p2[1], &cards[spot], decisionCards[(int) codeP2]);
+                spot += decisionCards[(int) codeP2];
+                ioRead(io, fd_hs_p2[0], &codeP2, 1);        // recieve next decision
+                ok = ioFlush(io);
+                if(trace != NULL)
+                    histRecord(trace->hist[TRACE_DEALER_P2], traceClock() - sent);
             }
+            if(!ok)                                         // a player is gone
+                break;
+
+            // the players' hands follow each final stand; with SQPOLL
+            // the kernel reads them while the dealer draws
+            seatResult seatP1, seatP2;                      // hands each player played
+            ioRead(io, fd_hs_p1[0], &seatP1, sizeof(seatP1));
+            ioRead(io, fd_hs_p2[0], &seatP2, sizeof(seatP2));
+
+            /* Dealer Odds */
+            // what the dealer can still draw, taken before its own draws move spot
+            int unseen[RANKS];
+            if(opts.expected)
+                shoeUnseen(cards, spot, unseen);
 
             /* Dealer Draws Cards */
-            valDealer = handValue(handDealer);              // compute dealer's hand value
-            statusDealer = dealer(valDealer);               // determine dealer's status
-            while(statusDealer == true)                     // hit while status is true
+            valDealer = dealerPlay(rules, cards, spot);     // draws from spot on
+
+            if(!ioFlush(io))                                // wait for the players' hands
             {
-                handDealer.push_back(cards[spot]);          // add card to hand
-                spot++;
-                valDealer = handValue(handDealer);          // recompute hand value
-                statusDealer = dealer(valDealer);           // recompute status of dealer
+                ok = false;
+                break;
             }
 
-            int valP1, valP2;                               // store final value of player hands
-            read(fd_hs_p1[0], &valP1, 4);                   // recieve final hand value of P1
-            read(fd_hs_p2[0], &valP2, 4);                   // recieve final hand value of P2
-
             /* Determine Wins */
-            if(valDealer > 21)                              // dealer busts
+            // hand by hand, see settleSeat(); a seat wins the game when it comes out ahead
+            bool dealerWon = false;
+            long netP1 = settleSeat(seatP1, valDealer, dealerWon);
+            long netP2 = settleSeat(seatP2, valDealer, dealerWon);
+            p1Wins += netP1 > 0;
+            p2Wins += netP2 > 0;
+            dealerWins += dealerWon;
+            tableNet.hands[0] += seatP1.hands;
+            tableNet.hands[1] += seatP2.hands;
+            tableNet.halves[0] += netP1;
+            tableNet.halves[1] += netP2;
+
+            /* Expected Outcome */
+            // --expected is only allowed for the hit/stand game: one hand per seat
+            if(opts.expected)
+            {
+                double expect[3];
+                expectedWins(dealerOutcome(oddsCache, unseen, cards[0]), seatP1.value[0], seatP2.value[0], expect);
+                estimateAdd(winEstimate, expect);
+            }
+
+            /* Publish Live Stats */
+            if(stats != NULL)
             {
-                if(valP1 <= 21)                             // dealer busts, player1 <= 21, player1 wins
-                    p1Wins++;
-                if(valP2 <= 21)                             // dealer busts, player2 <= 21, player2 wins
-                    p2Wins++;
-                if(valP1 > 21 || valP2 > 21)                // either player busts, dealer wins
-                    dealerWins++;
+                long seatWins[STATS_SEATS] = {p1Wins, p2Wins};
+                statsPublish(stats, i + 1, seatWins, dealerWins);
+                if(i % STATS_PERIOD == 0)                   // ioctl is a syscall, sample sparingly
+                {
+                    long depth[STATS_QUEUES];
+                    for(int q = 0; q < 4; q++)
+                    {
+                        int bytes;
+                        depth[q] = ioctl(pipeFds[q], FIONREAD, &bytes) == 0 ? bytes : -1;
+                    }
+                    statsQueues(stats, 4, pipeNames, depth);
+                }
             }
-            else                                            // dealer <= 21
+
+            /* Save Checkpoint */
+            if(opts.checkpoint != NULL && ((i + 1) % opts.every == 0 || i + 1 == opts.games))
             {
-                if(valP1 <= 21 && valP1 > valDealer)        // player1 <= 21 and player > dealer, player1 wins
-                    p1Wins++;
-                if(valP2 <= 21 && valP2 > valDealer)        // player2 <= 21 and player > dealer, player2 wins
-                    p2Wins++;
-                if(valP1 < valDealer || valP2 < valDealer)  // dealer <= 21 and player < dealer, dealer wins
-                    dealerWins++;
+                checkpoint ckpt;
+                memset(&ckpt, 0, sizeof(ckpt));             // zero padding so the checksum is stable
+                ckpt.variant = 'P';
+                ckpt.seed = opts.seed;
+                ckpt.gamesTotal = opts.games;
+                ckpt.nextGame = i + 1;
+                ckpt.p1Wins = p1Wins;
+                ckpt.p2Wins = p2Wins;
+                ckpt.dealerWins = dealerWins;
+                ckpt.rules = opts.rules;
+                ckpt.p1Hands = tableNet.hands[0];
+                ckpt.p2Hands = tableNet.hands[1];
+                ckpt.p1Net = tableNet.halves[0];
+                ckpt.p2Net = tableNet.halves[1];
+                if(!checkpointSave(opts.checkpoint, ckpt))
+                    cerr << "warning: could not write checkpoint " << opts.checkpoint << endl;
             }
         }
+        statsFinish(stats);                                 // mark done and remove the page
+        ioClose(io);
+        if(!ok)
+            cerr << "a player exited before the run finished" << endl;
 
         close(fd_cards_p1[1]);                              // close writing side card pipe p1
         close(fd_cards_p2[1]);                              // close writing side card pipe p2
         close(fd_hs_p1[0]);                                 // close reading side hit/stand pipe p1
         close(fd_hs_p2[0]);                                 // close reading side hit/stand pipe p2        
+        cleanupClear();                                     // stats page already removed
 
-        // 1000 games have finished 
-        // display win stats for players and dealer
-        cout << "\nPIPE IMPLEMENTATION" << endl;
-        cout << "Games:             1000" << endl;
-        cout << "----------------------------------------------" << endl;
-        cout << "Player One Wins:   " << p1Wins << " | Win Precentage: " << setprecision(4) << p1Wins/10.0 << "%" << endl;
-        cout << "Player Two Wins:   " << p2Wins << " | Win Precentage: " << setprecision(4) << p2Wins/10.0 << "%" << endl;
-        cout << "Dealer Wins:       " << dealerWins << " | Win Precentage: " << setprecision(4) <<dealerWins/10.0 << "%" << endl;
+        waitpid(pid, NULL, 0);                              // reap player 1 (which reaps player 2)
 
-        return 0;
+        wins[0] = p1Wins;                                   // hand totals back to main
+        wins[1] = p2Wins;
+        wins[2] = dealerWins;
+        return ok;
     }
 
     /* Worker Player Processes */
     else
     {
+        followParent(dealerPid);                        // exit if the dealer is killed
+
         /* Second fork() */
+        pid_t p1Pid = getpid();                         // player 2 watches player 1
         pid_t pid2 = fork();
 
         if(pid2 < 0)                                    // fork failure
         {
-            return 1;
+            exit(1);                                    // never return into the dealer's code
         }
         
         /* Player 1 Process */
         else if(pid2 > 0)
         {
-            vector<char> handP1;                        // p1 hand vector
-            char c1, c2;                                // first two cards from dealer
-            int valP1 = 0;                              // value of hand
-            bool hitStand = false;                      // hit or stand determination
+            if(!pinSelf(opts.cpus[1]))
+                cerr << "warning: could not pin player one to cpu " << opts.cpus[1] << ", running unpinned" << endl;
+
+            char first[3];                              // first two cards and the dealer's upcard
+            seatResult seat;                            // hands played, for the dealer
+            char reply[1 + sizeof(seatResult)];         // stand signal and the hands
+
+            pipeIO io;                                  // plain calls or io_uring, see --uring
+            ioOpen(io, opts.uring);
+            pipeDeal deal = {&io, fd_cards_p1[0], fd_hs_p1[1], TRACE_P1};
 
             close(fd_cards_p1[1]);                      // close writing end of card pipe for p1
             close(fd_hs_p1[0]);                         // close reading end of hs pipe for p1
 
-            // iterations must be the same amount as parent for loop (1000)
-            for(int p1 = 0; p1 < 1000; p1++)
+            // iterations must be the same amount as parent for loop (opts.games)
+            for(long p1 = opts.first; p1 < opts.games; p1++)
             {
-                handP1.clear();                         // clear hand
+                ioRead(io, fd_cards_p1[0], first, 3);   // read the first two cards and the upcard
+                if(!ioFlush(io))                        // (last game's reply goes out in the same batch)
+                    exit(1);                            // pipe closed, dealer is gone
 
-                read(fd_cards_p1[0], &c1, 1);           // read first card
-                read(fd_cards_p1[0], &c2, 1);           // read second card
-                handP1.push_back(c1);                   // add first card to vector
-                handP1.push_back(c2);                   // add second card to vector
+                playSeat(rules, 0, first, first[2], deal, seat);   // decisions go out through deal
 
-                valP1 = handValue(handP1);              // calculate current total
-
-                hitStand = playerOne(valP1);
-                write(fd_hs_p1[1], &hitStand, 1);       // send initial hit/stand signal
-                while(hitStand == true)                 // while hit is true
-                {
-                    char temp;
-                    read(fd_cards_p1[0], &temp, 1);     // recieve one more card
-                    handP1.push_back(temp);             // add card to hand
-                    valP1 = handValue(handP1);          // recompute hand value
-                    hitStand = playerOne(valP1);        // redetermine status
-                    write(fd_hs_p1[1], &hitStand, 1);   // send hit signal to dealer via fd_hs_p1
-                }
-
-                write(fd_hs_p1[1], &valP1, 4);          // send final hand value to dealer
+                // stand and the hands in one write: a batch may not hold
+                // two writes to the same pipe, their order is not kept
+                reply[0] = DEC_STAND;
+                memcpy(&reply[1], &seat, sizeof(seat));
+                ioWrite(io, fd_hs_p1[1], reply, sizeof(reply));   // send stand and hands to dealer
             }
+            ioFlush(io);                                // last game's reply
+            ioClose(io);
 
             close(fd_cards_p1[0]);                      // close reading side card pipe p1
             close(fd_hs_p1[1]);                         // close writing side hit/stand pipe p1
 
+            waitpid(pid2, NULL, 0);                     // player 2 exits on SIGTERM once player 1 is gone
             exit(0);                                    // exit completed process
         }
 
         /* Player 2 Process */
         else
         {
-            vector<char> handP2;                        // p2 hand vector
-            char c1, c2;                                // first two cards from dealer
-            int valP2 = 0;                              // value of hand
-            bool hitStand = false;                      // hit or stand determination
+            followParent(p1Pid);                        // exit if player 1 is killed
+            if(!pinSelf(opts.cpus[2]))
+                cerr << "warning: could not pin player two to cpu " << opts.cpus[2] << ", running unpinned" << endl;
+
+            char first[3];                              // first two cards and the dealer's upcard
+            seatResult seat;                            // hands played, for the dealer
+            char reply[1 + sizeof(seatResult)];         // stand signal and the hands
+
+            pipeIO io;                                  // plain calls or io_uring, see --uring
+            ioOpen(io, opts.uring);
+            pipeDeal deal = {&io, fd_cards_p2[0], fd_hs_p2[1], TRACE_P2};
 
             close(fd_cards_p2[1]);                      // close writing end of card pipe for p2
             close(fd_hs_p2[0]);                         // close reading end of hs pipe for p2
 
-            // iterations must be the same as parent for loop (1000)
-            for(int p2 = 0; p2 < 1000; p2++)
+            // iterations must be the same as parent for loop (opts.games)
+            for(long p2 = opts.first; p2 < opts.games; p2++)
             {
-                handP2.clear();                         // clear hand
+                ioRead(io, fd_cards_p2[0], first, 3);   // read the first two cards and the upcard
+                if(!ioFlush(io))                        // (last game's reply goes out in the same batch)
+                    exit(1);                            // pipe closed, dealer is gone
 
-                read(fd_cards_p2[0], &c1, 1);           // read first card
-                read(fd_cards_p2[0], &c2, 1);           // read second card
-                handP2.push_back(c1);                   // add first card to vector
-                handP2.push_back(c2);                   // add second card to vector
+                playSeat(rules, 1, first, first[2], deal, seat);   // decisions go out through deal
 
-                valP2 = handValue(handP2);              // calculate current total
-
-                hitStand = playerTwo(valP2);
-                write(fd_hs_p2[1], &hitStand, 1);       // send initial hit/stand signal
-                while(hitStand == true)                 // while hit is true
-                {
-                    char temp;
-                    read(fd_cards_p2[0], &temp, 1);     // recieve one more card
-                    handP2.push_back(temp);             // add card to hand
-                    valP2 = handValue(handP2);          // recompute hand value
-                    hitStand = playerTwo(valP2);        // redetermine status
-                    write(fd_hs_p2[1], &hitStand, 1);   // send hit signal to dealer via fd_hs_p2
-                }
-
-                write(fd_hs_p2[1], &valP2, 4);          // send final hand value to dealer
+                // stand and the hands in one write: a batch may not hold
+                // two writes to the same pipe, their order is not kept
+                reply[0] = DEC_STAND;
+                memcpy(&reply[1], &seat, sizeof(seat));
+                ioWrite(io, fd_hs_p2[1], reply, sizeof(reply));   // send stand and hands to dealer
             }
+            ioFlush(io);                                // last game's reply
+            ioClose(io);
 
             close(fd_cards_p2[0]);                      // close reading side card pipe p2
             close(fd_hs_p2[1]);                         // close writing side hit/stand pipe p2
@@ -297,144 +552,3 @@ int main(int argc, char *argv[])
         }
     }
 }
-
-/***************************************************************************
-* int playerOne(int val)
-* Author: Milan Gulati
-* Description: Player one's hit/stand strategy. Hits when less than 15.
-*              Stands when greater than equal to 15.
-*              Hit returns true. Stand returns false.
-*
-* Parameters:
-*   val         I/P     int     Integer value of current hand  
-*   playerOne   O/P     bool    Hit or stand signal for player one process
-***************************************************************************/
-bool playerOne(int val)
-{
-    if(val < 15)    // hit if hand < 15
-        return true;
-    return false;   // stand otherwise
-}
-
-/***************************************************************************
-* int playerTwo(int val)
-* Author: Milan Gulati
-* Description: Player two's hit/stand strategy. Hits when less than 18.
-*              Stands when greater than equal to 18.
-*              Hit returns true. Stand returns false.
-*
-* Parameters:
-*   val         I/P     int     Integer value of current hand  
-*   playerTwo   O/P     bool    Hit or stand signal for player two process
-***************************************************************************/
-bool playerTwo(int val)
-{
-    if(val < 18)    // hit if hand < 18
-        return true;
-    return false;   // stand otherwise
-}
-
-/***************************************************************************
-* int dealer(int val)
-* Author: Milan Gulati
-* Description: Dealer's hit/stand rule. Hits when less than 17.
-*              Stands when greater than equal to 17.
-*              Hit returns true. Stand returns false.
-*
-* Parameters:
-*   val         I/P     int     Integer value of current hand  
-*   dealer      O/P     bool    Hit or stand signal for dealer process
-***************************************************************************/
-bool dealer(int val)
-{
-    if(val < 17)    // hit if hand < 17
-        return true;
-    return false;   // stand otherwise
-}
-
-/***************************************************************************
-* int handValue(vector<char> hand)
-* Author: Milan Gulati
-* Description: Computes the integer value of the hand vector argument. Used
-*              Aces are treated specially and are dependent on the value of
-*              the other cards in the hand.
-*
-* Parameters:
-*   hand        I/P     vector<char>    Vector of chars containing cards in current hand 
-*   handValue   O/P     int             Integer value of hand computed from vector hand
-***************************************************************************/
-int handValue(vector<char> hand)
-{
-    int sum = 0;                                        // running sum of hand
-    int aces = count(hand.begin(), hand.end(), 'A');    // occurences of 'A' in vector
-
-    // if aces exist in hand
-    if(aces > 0)
-    {
-        // iterate through hand and sum non-ace values
-        for(auto c: hand)
-        {
-            if(c != 'A')                                // card must not be an ace
-            {
-                if(c == 'T')                            // 'T' equivalent to 10,J,Q,K
-                    sum += 10;                          // add to sum
-                else                                    // treat all other cards as face value
-                {
-                    int val = c - '0';                  // convert char to int
-                    sum += val;                         // add to sum
-                }
-            }
-        }
-
-        // remaining cards are aces
-        // depending on how many aces are present
-        // the values will be treated as 1 for each ace accordingly
-        switch (aces)
-        {
-        case 1: /* One Ace: 1 or 11 */
-            if(sum <= 10)                               // if existing sum is able to fit 11 (blackjack if sum = 10!)
-                sum += 11;
-            else                                        // else treat aces as 1
-                sum += 1;
-            break;
-        case 2: /* Two Ace: 2 or 12 */
-            if(sum <= 9)                                // existing sum able to fit 12 (11, 1)
-                sum += 12;
-            else                                        // else treat aces as 1 (1, 1)
-                sum += 2;
-            break;
-        case 3: /* Three Ace: 3 or 13 */
-            if(sum <= 8)                                // existing sum able to fit 13 (11, 1, 1)
-                sum += 13;
-            else                                        // else treat aces as 1 (1, 1, 1)
-                sum += 3;
-            break;
-        case 4: /* Four Ace: 4 or 14 */
-            if(sum <= 7)                                // existing sum able to fit 14 (11, 1, 1, 1)
-                sum += 14;
-            else                                        // else treat aces as 1 (1, 1, 1, 1)
-                sum += 4;
-            break;
-        default:                                        // default case will not occur
-            break;
-        }
-    }
-
-    // else no aces exist in hand
-    else 
-    {
-        // iterate though hand and sum up every value
-        // no need to account for aces in this case
-        for(auto c: hand)
-        {
-            if(c == 'T')                                // 'T' equivalent to 10,J,Q,K
-                sum += 10;                              // add to sum
-            else                                        // treat all other cards as face value
-            {
-                int val = c - '0';                      // convert char to int
-                sum += val;                             // add to sum
-            }
-        }
-    }
-    return sum;                                         // return sum of hand
-}
@@ -0,0 +1,488 @@
+/***************************************************************************
+* File: blackjack_results.h
+* Author: Milan Gulati
+* Procedures:
+* resultsMap        - maps a results file and checks its header
+* resultsUnmap      - unmaps a results file
+* resultsOpen       - opens a results file read only for resultsInts/resultsFloats
+* resultsFind       - finds a column by name
+* resultsInts       - typed array of an integer column
+* resultsFloats     - typed array of a floating point column
+* resultsRebuild    - rewrites a results file with room for more rows
+* resultsAppend     - appends one row, creating or growing the file as needed
+* standsAt          - lowest hand a hit/stand rule stands on
+* resultsRow        - fills a row from a finished run
+***************************************************************************/
+
+#ifndef BLACKJACK_RESULTS_H
+#define BLACKJACK_RESULTS_H
+
+/* Import Libraries */
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <math.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <string>
+#include <vector>
+#include "blackjack_options.h"
+#include "blackjack_dealercache.h"
+#include "blackjack_game.h"
+
+#define RESULTS_MAGIC       0x424a524553303031L     // "BJRES001"
+#define RESULTS_VERSION     1
+#define RESULTS_MAX_COLS    32                      // columns a file can describe
+#define RESULTS_NAME        24                      // column name, NUL terminated
+#define RESULTS_FIRST_ROWS  1024                    // rows in a new file, doubled when full
+#define RESULTS_ALIGN       64                      // every column starts on a cache line
+#define RESULTS_INT         1                       // column of long
+#define RESULTS_FLOAT       2                       // column of double, NaN when missing
+
+/*
+* A results file is a fixed header followed by one array per column, each
+* holding capacity 8 byte values. Row r of a column is simply array[r], so a
+* reader maps the file and filters a column as a plain typed array, with no
+* parsing at all. Rows are added in place under flock() with pwrite() and
+* published by bumping rows last; when the file is full it is rewritten with twice the
+* capacity to path.tmp and renamed over path, so readers that already have
+* the old file mapped keep a consistent copy.
+*/
+struct resultsColumn
+{
+    char name[RESULTS_NAME];                // e.g. "p1_wins"
+    long type;                              // RESULTS_INT or RESULTS_FLOAT
+    long offset;                            // file offset of the column's array
+};
+
+struct resultsHeader
+{
+    long magic;                             // RESULTS_MAGIC
+    long version;                           // RESULTS_VERSION
+    long columns;                           // columns in use in column[]
+    long capacity;                          // rows each column array has room for
+    long rows;                              // rows written, updated after the row's values
+    resultsColumn column[RESULTS_MAX_COLS];
+};
+
+// one value of a row; the column type says which member is used
+union resultsValue
+{
+    long i;
+    double d;
+};
+
+struct resultsField
+{
+    const char *name;
+    long type;
+};
+
+/*
+* the columns every variant writes, one row per run; sweeps filter on the
+* configuration columns and read the outcome columns
+*/
+static const resultsField resultsSchema[] = {
+    {"time",            RESULTS_INT},       // unix time the run finished
+    {"variant",         RESULTS_INT},       // 'M' message queues, 'P' pipes, 'H' shared deck
+    {"seed",            RESULTS_INT},       // seed the decks were dealt from
+    {"games",           RESULTS_INT},       // games in the run
+    {"played",          RESULTS_INT},       // games played by this invocation (fewer after --resume)
+    {"p1_stand",        RESULTS_INT},       // player one stands on this hand or more
+    {"p2_stand",        RESULTS_INT},       // player two stands on this hand or more
+    {"dealer_stand",    RESULTS_INT},       // dealer stands on this hand or more
+    {"p1_wins",         RESULTS_INT},
+    {"p2_wins",         RESULTS_INT},
+    {"dealer_wins",     RESULTS_INT},
+    {"p1_expected",     RESULTS_FLOAT},     // win rates from --expected, NaN without it
+    {"p2_expected",     RESULTS_FLOAT},
+    {"dealer_expected", RESULTS_FLOAT},
+    {"seconds",         RESULTS_FLOAT},     // wall clock of the run
+    {"games_per_sec",   RESULTS_FLOAT},
+    {"rules",           RESULTS_INT},       // RULE_* bits of --rules, 0 for hit/stand only
+    {"p1_net",          RESULTS_FLOAT},     // net units per game, NaN when not tallied (coordinator)
+    {"p2_net",          RESULTS_FLOAT},
+};
+#define RESULTS_COLS    ((int) (sizeof(resultsSchema) / sizeof(resultsSchema[0])))
+
+// a mapped results file
+struct resultsView
+{
+    void *map;                              // whole file, NULL if not mapped
+    size_t size;                            // bytes mapped
+    resultsHeader *header;                  // start of the map
+};
+
+/***************************************************************************
+* bool resultsMap(int fd, bool writable, resultsView &view)
+* Author: Milan Gulati
+* Description: Maps the whole file and checks that it is a results file
+*              whose columns all lie inside it.
+*
+* Parameters:
+*   fd          I/P     int             Open results file
+*   writable    I/P     bool            Map for writing rows as well
+*   view        O/P     resultsView &   Mapped file
+*   resultsMap  O/P     bool            False if the file is not a valid results file
+***************************************************************************/
+inline bool resultsMap(int fd, bool writable, resultsView &view)
+{
+    view.map = NULL;
+    struct stat st;
+    if(fstat(fd, &st) != 0 || st.st_size < (off_t) sizeof(resultsHeader))
+        return false;
+    void *map = mmap(NULL, st.st_size, PROT_READ | (writable ? PROT_WRITE : 0), MAP_SHARED, fd, 0);
+    if(map == MAP_FAILED)
+        return false;
+    view.map = map;
+    view.size = st.st_size;
+    view.header = (resultsHeader *) map;
+
+    const resultsHeader *h = view.header;
+    bool ok = h->magic == RESULTS_MAGIC && h->version == RESULTS_VERSION
+              && h->columns > 0 && h->columns <= RESULTS_MAX_COLS
+              && h->rows >= 0 && h->rows <= h->capacity;
+    for(long c = 0; ok && c < h->columns; c++)      // written so a damaged offset cannot overflow
+        ok = (h->column[c].type == RESULTS_INT || h->column[c].type == RESULTS_FLOAT)
+             && h->column[c].offset >= (long) sizeof(resultsHeader)
+             && h->column[c].offset <= (long) view.size
+             && h->capacity <= ((long) view.size - h->column[c].offset) / 8;
+    if(!ok)
+    {
+        munmap(map, view.size);
+        view.map = NULL;
+    }
+    return ok;
+}
+
+/***************************************************************************
+* void resultsUnmap(resultsView &view)
+* Author: Milan Gulati
+* Description: Unmaps a file mapped by resultsMap or resultsOpen.
+*
+* Parameters:
+*   view    I/O     resultsView &   Mapped file
+***************************************************************************/
+inline void resultsUnmap(resultsView &view)
+{
+    if(view.map != NULL)
+        munmap(view.map, view.size);
+    view.map = NULL;
+}
+
+/***************************************************************************
+* bool resultsOpen(const char *path, resultsView &view)
+* Author: Milan Gulati
+* Description: Maps a results file read only. Loading costs one mmap no
+*              matter how many rows the file has; pages are read as the
+*              columns are touched.
+*
+* Parameters:
+*   path        I/P     const char *    Results file
+*   view        O/P     resultsView &   Mapped file
+*   resultsOpen O/P     bool            False if missing or not a results file
+***************************************************************************/
+inline bool resultsOpen(const char *path, resultsView &view)
+{
+    view.map = NULL;
+    int fd = open(path, O_RDONLY);
+    if(fd == -1)
+        return false;
+    bool ok = resultsMap(fd, false, view);
+    close(fd);                              // the mapping stays valid
+    return ok;
+}
+
+/***************************************************************************
+* int resultsFind(const resultsView &view, const char *name)
+* Author: Milan Gulati
+* Description: Looks a column up by name.
+*
+* Parameters:
+*   view        I/P     const resultsView & Mapped file
+*   name        I/P     const char *        Column name
+*   resultsFind O/P     int                 Column index, -1 if there is none
+***************************************************************************/
+inline int resultsFind(const resultsView &view, const char *name)
+{
+    for(long c = 0; c < view.header->columns; c++)
+        if(strncmp(view.header->column[c].name, name, RESULTS_NAME) == 0)
+            return (int) c;
+    return -1;
+}
+
+/***************************************************************************
+* const long *resultsInts(const resultsView &view, int c)
+* Author: Milan Gulati
+* Description: The values of an integer column, one per row.
+*
+* Parameters:
+*   view        I/P     const resultsView & Mapped file
+*   c           I/P     int                 Column index
+*   resultsInts O/P     const long *        header->rows values, NULL if not an integer column
+***************************************************************************/
+inline const long *resultsInts(const resultsView &view, int c)
+{
+    if(view.header->column[c].type != RESULTS_INT)
+        return NULL;
+    return (const long *) ((const char *) view.map + view.header->column[c].offset);
+}
+
+/***************************************************************************
+* const double *resultsFloats(const resultsView &view, int c)
+* Author: Milan Gulati
+* Description: The values of a floating point column, one per row.
+*
+* Parameters:
+*   view            I/P     const resultsView & Mapped file
+*   c               I/P     int                 Column index
+*   resultsFloats   O/P     const double *      header->rows values, NULL if not a float column
+***************************************************************************/
+inline const double *resultsFloats(const resultsView &view, int c)
+{
+    if(view.header->column[c].type != RESULTS_FLOAT)
+        return NULL;
+    return (const double *) ((const char *) view.map + view.header->column[c].offset);
+}
+
+/***************************************************************************
+* bool resultsRebuild(const char *path, const resultsView *old, long capacity)
+* Author: Milan Gulati
+* Description: Writes a results file with the current schema and room for
+*              capacity rows to path.tmp and renames it over path. Rows of
+*              old, if given, are copied column by column by name; columns
+*              old has that the schema lacks are kept after the schema's, and
+*              schema columns old lacks are filled with 0 or NaN. The caller
+*              holds the lock on the file being replaced.
+*
+* Parameters:
+*   path            I/P     const char *            Results file
+*   old             I/P     const resultsView *     Current contents, NULL for a new file
+*   capacity        I/P     long                    Rows the new file has room for
+*   resultsRebuild  O/P     bool                    False if the file could not be written
+***************************************************************************/
+inline bool resultsRebuild(const char *path, const resultsView *old, long capacity)
+{
+    std::vector<resultsColumn> cols;
+    for(int c = 0; c < RESULTS_COLS; c++)
+    {
+        resultsColumn col;
+        memset(&col, 0, sizeof(col));
+        strncpy(col.name, resultsSchema[c].name, RESULTS_NAME - 1);
+        col.type = resultsSchema[c].type;
+        cols.push_back(col);
+    }
+    long rows = old != NULL ? old->header->rows : 0;
+    for(long c = 0; old != NULL && c < old->header->columns; c++)
+    {
+        bool known = false;
+        for(auto &col: cols)
+            known = known || strncmp(col.name, old->header->column[c].name, RESULTS_NAME) == 0;
+        if(!known && cols.size() < RESULTS_MAX_COLS)
+            cols.push_back(old->header->column[c]);
+    }
+
+    resultsHeader h;
+    memset(&h, 0, sizeof(h));
+    h.magic = RESULTS_MAGIC;
+    h.version = RESULTS_VERSION;
+    h.columns = cols.size();
+    h.capacity = capacity;
+    h.rows = rows;
+    long offset = (sizeof(h) + RESULTS_ALIGN - 1) / RESULTS_ALIGN * RESULTS_ALIGN;
+    long span = (capacity * 8 + RESULTS_ALIGN - 1) / RESULTS_ALIGN * RESULTS_ALIGN;
+    for(size_t c = 0; c < cols.size(); c++)
+    {
+        h.column[c] = cols[c];
+        h.column[c].offset = offset + c * span;
+    }
+
+    char tmp[4096];
+    snprintf(tmp, sizeof(tmp), "%s.tmp", path);
+    int fd = open(tmp, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if(fd == -1)
+        return false;
+    bool ok = ftruncate(fd, offset + cols.size() * span) == 0
+              && pwrite(fd, &h, sizeof(h), 0) == (ssize_t) sizeof(h);
+
+    std::vector<resultsValue> column(rows);
+    for(size_t c = 0; ok && c < cols.size() && rows > 0; c++)
+    {
+        int from = old != NULL ? resultsFind(*old, h.column[c].name) : -1;
+        for(long r = 0; r < rows; r++)
+        {
+            if(from != -1)
+                memcpy(&column[r], (const char *) old->map + old->header->column[from].offset + r * 8, 8);
+            else if(h.column[c].type == RESULTS_FLOAT)
+                column[r].d = NAN;
+            else
+                column[r].i = 0;
+        }
+        ok = pwrite(fd, column.data(), rows * 8, h.column[c].offset) == (ssize_t) (rows * 8);
+    }
+    ok = fsync(fd) == 0 && ok;              // data on disk before the rename
+    close(fd);
+
+    if(!ok || rename(tmp, path) == -1)
+    {
+        unlink(tmp);
+        return false;
+    }
+    return true;
+}
+
+/***************************************************************************
+* bool resultsAppend(const char *path, const resultsValue row[RESULTS_COLS])
+* Author: Milan Gulati
+* Description: Appends one row to path, creating the file if needed. The
+*              file is locked with flock() for the append, so any number of
+*              runs of a sweep can share one results file. A full file, or
+*              one written with an older schema, is rebuilt first. If the
+*              file was replaced while waiting for the lock, the new one is
+*              opened and locked instead.
+*
+* Parameters:
+*   path            I/P     const char *        Results file
+*   row             I/P     const resultsValue  Values in resultsSchema order
+*   resultsAppend   O/P     bool                False on an I/O error or a file that is not a results file
+***************************************************************************/
+inline bool resultsAppend(const char *path, const resultsValue row[RESULTS_COLS])
+{
+    for(int attempt = 0; attempt < 16; attempt++)
+    {
+        int fd = open(path, O_RDWR | O_CREAT, 0644);
+        if(fd == -1)
+            return false;
+        struct stat held, named;
+        if(flock(fd, LOCK_EX) != 0 || fstat(fd, &held) != 0)
+        {
+            close(fd);
+            return false;
+        }
+        if(stat(path, &named) != 0 || named.st_ino != held.st_ino)
+        {
+            close(fd);                      // replaced by another writer, lock the new file
+            continue;
+        }
+
+        if(held.st_size == 0)               // created just now
+        {
+            bool ok = resultsRebuild(path, NULL, RESULTS_FIRST_ROWS);
+            close(fd);
+            if(!ok)
+                return false;
+            continue;
+        }
+
+        // only the header is read; the row goes in with one pwrite per column
+        resultsHeader h;
+        if(pread(fd, &h, sizeof(h), 0) != (ssize_t) sizeof(h) || h.magic != RESULTS_MAGIC
+           || h.version != RESULTS_VERSION || h.columns < 1 || h.columns > RESULTS_MAX_COLS)
+        {
+            close(fd);
+            return false;
+        }
+        bool current = h.columns >= RESULTS_COLS;
+        for(int c = 0; current && c < RESULTS_COLS; c++)
+            current = strncmp(h.column[c].name, resultsSchema[c].name, RESULTS_NAME) == 0
+                      && h.column[c].type == resultsSchema[c].type;
+        if(!current || h.rows >= h.capacity)
+        {
+            resultsView view;
+            bool ok = resultsMap(fd, false, view);
+            if(ok)
+            {
+                long capacity = h.rows >= h.capacity ? 2 * h.capacity : h.capacity;
+                ok = resultsRebuild(path, &view, capacity);
+                resultsUnmap(view);
+            }
+            close(fd);
+            if(!ok)
+                return false;
+            continue;
+        }
+
+        bool ok = true;
+        for(long c = 0; ok && c < h.columns; c++)
+        {
+            resultsValue v;
+            if(c < RESULTS_COLS)
+                v = row[c];
+            else if(h.column[c].type == RESULTS_FLOAT)
+                v.d = NAN;                  // a column this version does not know
+            else
+                v.i = 0;
+            ok = pwrite(fd, &v, 8, h.column[c].offset + h.rows * 8) == 8;
+        }
+        h.rows++;                           // publish the row last
+        ok = ok && pwrite(fd, &h.rows, sizeof(h.rows), offsetof(resultsHeader, rows)) == (ssize_t) sizeof(h.rows);
+        close(fd);                          // releases the lock
+        return ok;
+    }
+    return false;
+}
+
+/***************************************************************************
+* int standsAt(bool (*rule)(int))
+* Author: Milan Gulati
+* Description: Lowest hand value a hit/stand rule stands on, so the
+*              results record the strategies that were actually played.
+*
+* Parameters:
+*   rule        I/P     bool (*)(int)   Strategy or dealer rule, true to hit
+*   standsAt    O/P     int             Lowest value it stands on, 22 if it never does
+***************************************************************************/
+inline int standsAt(bool (*rule)(int))
+{
+    int val = 2;
+    while(val <= 21 && rule(val))
+        val++;
+    return val;
+}
+
+/***************************************************************************
+* void resultsRow(resultsValue row[], char variant, const simOptions &opts,
+*                 const long wins[3], long played, double elapsed, const estimate *est,
+*                 const netTally &net)
+* Author: Milan Gulati
+* Description: Fills a row of resultsSchema from a finished run.
+*
+* Parameters:
+*   row         O/P     resultsValue []     RESULTS_COLS values
+*   variant     I/P     char                'M', 'P' or 'H'
+*   opts        I/P     const simOptions &  Options of the run
+*   wins        I/P     const long [3]      Player 1, player 2 and dealer wins
+*   played      I/P     long                Games played by this invocation
+*   elapsed     I/P     double              Wall clock seconds
+*   est         I/P     const estimate *    Expected wins, NULL without --expected
+*   net         I/P     const netTally &    Net result of each seat over the whole run
+***************************************************************************/
+inline void resultsRow(resultsValue row[], char variant, const simOptions &opts,
+                       const long wins[3], long played, double elapsed, const estimate *est,
+                       const netTally &net)
+{
+    int c = 0;
+    row[c++].i = time(NULL);
+    row[c++].i = variant;
+    row[c++].i = (long) opts.seed;
+    row[c++].i = opts.games;
+    row[c++].i = played;
+    row[c++].i = standsAt(playerOne);
+    row[c++].i = standsAt(playerTwo);
+    row[c++].i = standsAt(dealer);
+    for(int s = 0; s < 3; s++)
+        row[c++].i = wins[s];
+    for(int s = 0; s < 3; s++)
+        row[c++].d = est != NULL && est->games > 0 ? est->expected[s] / est->games : NAN;
+    row[c++].d = elapsed;
+    row[c++].d = elapsed > 0 ? played / elapsed : 0.0;
+    row[c++].i = opts.rules;
+    for(int s = 0; s < 2; s++)
+        row[c++].d = net.hands[s] > 0 ? net.halves[s] / 2.0 / opts.games : NAN;
+}
+
+#endif
@@ -0,0 +1,398 @@
+/***************************************************************************
+* File: blackjack_shm.cpp
+* Author: Milan Gulati
+* Procedures:
+* main          - parses options and runs the game locally, as an agent or as a coordinator
+* runTable      - maps the shared deck and forks dealer and player processes, manages the processes
+***************************************************************************/
+
+/* Import Libraries */
+#include <iostream>
+#include <algorithm>
+#include <iomanip>
+#include <bits/stdc++.h>
+#include <unistd.h>
+#include <sys/wait.h>
+#include "blackjack_options.h"
+#include "blackjack_stats.h"
+#include "blackjack_deck.h"
+#include "blackjack_shuffle.h"
+#include "blackjack_game.h"
+#include "blackjack_checkpoint.h"
+#include "blackjack_signals.h"
+#include "blackjack_dist.h"
+#include "blackjack_affinity.h"
+#include "blackjack_dealercache.h"
+#include "blackjack_results.h"
+#include "blackjack_turn.h"
+
+using namespace std;
+
+/* Function Prototypes */
+bool runTable(simOptions &opts, long wins[3]);  // play games on the local engine
+
+dealerCache oddsCache = {{}, {}, 0, 0, 0, handValue, dealer, {}, {}};   // exact dealer outcomes for --expected
+estimate winEstimate = {0, {0, 0, 0}, {0, 0, 0}};               // expected wins summed by the dealer
+netTally tableNet = {{0, 0}, {0, 0}};                           // hands and net units summed by the dealer
+
+/***************************************************************************
+* int main()
+* Author: Milan Gulati
+* Description: Parses the command line and plays the games. By default the
+*              games are played by runTable() on this machine. With --agent
+*              the program serves shards to a coordinator instead, and with
+*              --coordinate it splits the run into shards played by agents.
+*              Displays the win stats of the dealer and players.
+*
+* Parameters:
+*   argc    I/P     int         Number of arguments on command line
+*   argv    I/P     char *[]    Arguments listed on command line
+*   main    O/P     int         Status code returns 1 on bad options, bad checkpoint or failed run
+***************************************************************************/
+int main(int argc, char *argv[])
+{
+    simOptions opts;    // games to play, monitoring
+    if(!parseOptions(argc, argv, opts))
+    {
+        usage(argv[0]);
+        return 1;
+    }
+
+    long wins[3] = {0, 0, 0};   // player 1, player 2, dealer wins
+
+    /* Resume From Checkpoint */
+    // the checkpoint replaces seed, game count, rules, win counters and net tally
+    // games before nextGame are never replayed
+    if(opts.resume)
+    {
+        checkpoint ckpt;
+        if(!checkpointLoad(opts.checkpoint, ckpt) || ckpt.variant != 'H')
+        {
+            cerr << "cannot resume: " << opts.checkpoint << " is not a valid shared deck checkpoint" << endl;
+            return 1;
+        }
+        opts.seed = ckpt.seed;
+        opts.games = ckpt.gamesTotal;
+        opts.first = ckpt.nextGame;
+        wins[0] = ckpt.p1Wins;
+        wins[1] = ckpt.p2Wins;
+        wins[2] = ckpt.dealerWins;
+        opts.rules = ckpt.rules;
+        tableNet.hands[0] = ckpt.p1Hands;
+        tableNet.hands[1] = ckpt.p2Hands;
+        tableNet.halves[0] = ckpt.p1Net;
+        tableNet.halves[1] = ckpt.p2Net;
+        if(!optionsValid(opts))             // e.g. saved with --rules, resumed with --expected
+        {
+            cerr << "cannot resume: the run saved in " << opts.checkpoint << " conflicts with the options given" << endl;
+            return 1;
+        }
+    }
+
+    /* Cpu Placement */
+    if(opts.pin != NULL)
+    {
+        if(!placeTable(opts.pin, opts.cpus))
+        {
+            cerr << "cannot place processes on cpus \"" << opts.pin << "\"" << endl;
+            return 1;
+        }
+        cerr << "dealer on cpu " << opts.cpus[0] << ", player one on cpu " << opts.cpus[1]
+             << ", player two on cpu " << opts.cpus[2] << endl;
+    }
+
+    /* Pipe Transport */
+    if(opts.uring != 0)
+    {
+        cerr << "--uring batches pipe reads and writes, which the shared deck variant does not make" << endl;
+        return 1;
+    }
+
+    /* Latency Tracing */
+    // players draw their own cards here, there are no card messages to time
+    if(opts.trace != NULL)
+    {
+        cerr << "--trace times card messages, which the shared deck variant does not send" << endl;
+        return 1;
+    }
+
+    /* Play Games */
+    long played = opts.games - opts.first;  // games this process plays
+    long before[3] = {wins[0], wins[1], wins[2]}; // wins carried over from a checkpoint
+    double start = monotonicNow();          // wall clock for the throughput line
+    if(opts.agentPort != 0)                 // serve shards, returns on a socket error
+        return runAgent(opts, runTable);
+    if(opts.agents != NULL)                 // shards played by agents
+    {
+        if(runCoordinator(opts, wins) != 0)
+            return 1;
+    }
+    else if(!runTable(opts, wins))          // all games played here
+        return 1;
+    double elapsed = monotonicNow() - start; // includes fork and table setup
+
+    long p1Wins = wins[0];
+    long p2Wins = wins[1];
+    long dealerWins = wins[2];
+
+    // all games have finished 
+    // display win stats for players and dealer
+    cout << "\nSHARED DECK IMPLEMENTATION" << endl;
+    cout << "Games:             " << opts.games << endl;
+    cout << "Seed:              " << opts.seed << endl;
+    cout << "----------------------------------------------" << endl;
+    cout << "Player One Wins:   " << p1Wins << " | Win Precentage: " << setprecision(4) << 100.0*p1Wins/opts.games << "%" << endl;
+    cout << "Player Two Wins:   " << p2Wins << " | Win Precentage: " << setprecision(4) << 100.0*p2Wins/opts.games << "%" << endl;
+    cout << "Dealer Wins:       " << dealerWins << " | Win Precentage: " << setprecision(4) << 100.0*dealerWins/opts.games << "%" << endl;
+    if(opts.rules != 0)
+        rulesReport(opts.rules, tableNet, opts.games);
+    cout << "----------------------------------------------" << endl;
+    cout << "Time:              " << setprecision(4) << elapsed << " s | Games/sec: " << (long) (played / elapsed) << endl;
+
+    if(opts.expected)
+    {
+        long counted[3] = {p1Wins - before[0], p2Wins - before[1], dealerWins - before[2]};
+        estimateReport(winEstimate, counted, oddsCache);
+    }
+
+    if(opts.results != NULL)
+    {
+        resultsValue row[RESULTS_COLS];                 // one row per run, see blackjack_results.h
+        resultsRow(row, 'H', opts, wins, played, elapsed, opts.expected ? &winEstimate : NULL, tableNet);
+        if(!resultsAppend(opts.results, row))
+        {
+            cerr << "cannot append results to " << opts.results << endl;
+            return 1;
+        }
+    }
+
+    return 0;
+}
+
+/***************************************************************************
+* bool runTable(simOptions &opts, long wins[3])
+* Author: Milan Gulati
+* Description: Maps the shared table, creates the dealer and player processes.
+*              The dealer (manager) shuffles each game's deck into shared
+*              memory and hands the turn to player one. Each player (worker)
+*              takes its two cards and draws what its decisions take (hits,
+*              doubles, splits) straight from the deck, records its hands
+*              and passes the turn on; player two
+*              passes it back to the dealer, who draws, settles the game and
+*              starts the next one. No card is copied through the kernel: the
+*              only system calls left are futex waits and wakes when an actor
+*              has to sleep for its turn. Tracks the wins of the dealer and
+*              players for games opts.first to opts.games - 1. Only the dealer
+*              returns; the players exit when done.
+*
+* Parameters:
+*   opts        I/P     simOptions &    Seed, game range, monitoring and checkpoint settings
+*   wins        I/O     long [3]        Player 1, player 2 and dealer wins, added to
+*   runTable    O/P     bool            False on failure of mmap() or fork(), or if a player dies
+***************************************************************************/
+bool runTable(simOptions &opts, long wins[3])
+{
+    long dealerWins = wins[2];  // track dealer wins
+    long p1Wins = wins[0];      // track player 1 wins
+    long p2Wins = wins[1];      // track player 2 wins
+
+    /*
+    * Map Shared Table
+    * the deck, draw cursor and turn counter live in one MAP_SHARED page
+    * cards 0,1 are the dealer's, 2,3 player one's, 4,5 player two's, and hits
+    * are drawn from 6 on in turn order, so every game uses the same cards
+    * as the message queue and pipe variants
+    */
+    sharedTable *table = tableCreate();
+    if(table == NULL)
+        return false;
+
+    ruleTables rules;                               // the game as lookups, inherited by the players
+    rulesBuild(rules, opts.rules);
+
+    /* First fork() */
+    pid_t dealerPid = getpid();     // players watch this pid
+    pid_t pid = fork();
+
+    if(pid < 0) // fork function returns negative on failure
+    {
+        munmap(table, sizeof(sharedTable));
+        return false;
+    }
+
+    /* Parent Dealer Process */
+    else if(pid > 0)
+    {
+        if(!pinSelf(opts.cpus[0]))                          // always true without --pin
+            cerr << "warning: could not pin dealer to cpu " << opts.cpus[0] << ", running unpinned" << endl;
+
+        int valDealer = 0;                                  // value of dealer's hand
+        bool ok = true;                                     // false once a player has died
+
+        installCleanup();                                   // remove the stats page if interrupted
+
+        statsPage *stats = NULL;                            // live metrics for bjstat
+        if(opts.stats)
+        {
+            pid_t owner;
+            stats = statsCreate('H', "shm", opts.first, opts.games, owner);
+            if(stats == NULL && owner != 0)
+                cerr << "stats page is in use by pid " << owner << " (another run in this directory), continuing without it" << endl;
+            else if(stats == NULL)
+                cerr << "stats page unavailable, continuing without it" << endl;
+            else
+                cleanupShm(stats->shmid);
+        }
+
+        deckRing deal;                                      // decks of the next games, dealt in batches
+        ringStart(deal, opts.seed);
+        for(long i = opts.first; i < opts.games; i++)
+        {
+            /* Start Round */
+            memcpy(table->cards, ringDeal(deal, i), DECK_SIZE); // deal the deck for game i
+            table->spot = 6;                                // first card after the initial hands
+            turnPass(table, TURN_P1);                       // players draw for themselves
+
+            if(!turnWait(table, TURN_DEALER, pid))          // player two passes the turn back
+            {
+                ok = false;
+                break;
+            }
+
+            /* Dealer Odds */
+            // what the dealer can still draw, taken before its own draws move table->spot
+            int unseen[RANKS];
+            if(opts.expected)
+                shoeUnseen(table->cards, table->spot, unseen);
+
+            /* Dealer Draws Cards */
+            valDealer = dealerPlay(rules, table->cards, table->spot);   // draws from table->spot on
+
+            /* Determine Wins */
+            // hand by hand, see settleSeat(); a seat wins the game when it comes out ahead
+            bool dealerWon = false;
+            long netP1 = settleSeat(table->seat[0], valDealer, dealerWon);
+            long netP2 = settleSeat(table->seat[1], valDealer, dealerWon);
+            p1Wins += netP1 > 0;
+            p2Wins += netP2 > 0;
+            dealerWins += dealerWon;
+            tableNet.hands[0] += table->seat[0].hands;
+            tableNet.hands[1] += table->seat[1].hands;
+            tableNet.halves[0] += netP1;
+            tableNet.halves[1] += netP2;
+
+            /* Expected Outcome */
+            // --expected is only allowed for the hit/stand game: one hand per seat
+            if(opts.expected)
+            {
+                double expect[3];
+                expectedWins(dealerOutcome(oddsCache, unseen, table->cards[0]), table->seat[0].value[0],
+                             table->seat[1].value[0], expect);
+                estimateAdd(winEstimate, expect);
+            }
+
+            /* Publish Live Stats */
+            if(stats != NULL)
+            {
+                long seatWins[STATS_SEATS] = {p1Wins, p2Wins};
+                statsPublish(stats, i + 1, seatWins, dealerWins);
+            }
+
+            /* Save Checkpoint */
+            if(opts.checkpoint != NULL && ((i + 1) % opts.every == 0 || i + 1 == opts.games))
+            {
+                checkpoint ckpt;
+                memset(&ckpt, 0, sizeof(ckpt));             // zero padding so the checksum is stable
+                ckpt.variant = 'H';
+                ckpt.seed = opts.seed;
+                ckpt.gamesTotal = opts.games;
+                ckpt.nextGame = i + 1;
+                ckpt.p1Wins = p1Wins;
+                ckpt.p2Wins = p2Wins;
+                ckpt.dealerWins = dealerWins;
+                ckpt.rules = opts.rules;
+                ckpt.p1Hands = tableNet.hands[0];
+                ckpt.p2Hands = tableNet.hands[1];
+                ckpt.p1Net = tableNet.halves[0];
+                ckpt.p2Net = tableNet.halves[1];
+                if(!checkpointSave(opts.checkpoint, ckpt))
+                    cerr << "warning: could not write checkpoint " << opts.checkpoint << endl;
+            }
+        }
+        statsFinish(stats);                                 // mark done and remove the page
+        cleanupClear();                                     // stats page already removed
+
+        if(!ok)
+        {
+            cerr << "a player exited before the run finished" << endl;
+            kill(pid, SIGKILL);                             // already gone or dying; player 2 follows it
+        }
+        waitpid(pid, NULL, 0);                              // reap player 1 (which reaps player 2)
+        munmap(table, sizeof(sharedTable));
+
+        wins[0] = p1Wins;                                   // hand totals back to main
+        wins[1] = p2Wins;
+        wins[2] = dealerWins;
+        return ok;
+    }
+
+    /* Worker Player Processes */
+    else
+    {
+        followParent(dealerPid);                        // exit if the dealer is killed
+
+        /* Second fork() */
+        pid_t p1Pid = getpid();                         // player 2 watches player 1
+        pid_t pid2 = fork();
+
+        if(pid2 < 0)                                    // fork failure
+        {
+            exit(1);                                    // never return into the dealer's code
+        }
+        
+        /* Player 1 Process */
+        else if(pid2 > 0)
+        {
+            if(!pinSelf(opts.cpus[1]))
+                cerr << "warning: could not pin player one to cpu " << opts.cpus[1] << ", running unpinned" << endl;
+
+            deckDeal deal = {table->cards, &table->spot};  // draws straight from the shared deck
+
+            // iterations must be the same as parent for loop (opts.games)
+            for(long p1 = opts.first; p1 < opts.games; p1++)
+            {
+                if(!turnWait(table, TURN_P1, pid2))     // wait for the dealer to shuffle
+                    exit(1);                            // player 2 died
+
+                // initial hand straight from the deck, the dealer's upcard is card 0
+                playSeat(rules, 0, &table->cards[2], table->cards[0], deal, table->seat[0]);
+                turnPass(table, TURN_P2);
+            }
+
+            waitpid(pid2, NULL, 0);                     // player 2 exits on SIGTERM once player 1 is gone
+            exit(0);                                    // exit completed process
+        }
+
+        /* Player 2 Process */
+        else
+        {
+            followParent(p1Pid);                        // exit if player 1 is killed
+            if(!pinSelf(opts.cpus[2]))
+                cerr << "warning: could not pin player two to cpu " << opts.cpus[2] << ", running unpinned" << endl;
+
+            deckDeal deal = {table->cards, &table->spot};  // draws straight from the shared deck
+
+            // iterations must be the same as parent for loop (opts.games)
+            for(long p2 = opts.first; p2 < opts.games; p2++)
+            {
+                turnWait(table, TURN_P2, 0);            // player 1 is done drawing
+
+                // initial hand straight from the deck, the dealer's upcard is card 0
+                playSeat(rules, 1, &table->cards[4], table->cards[0], deal, table->seat[1]);
+                turnPass(table, TURN_DEALER);
+            }
+
+            exit(0);                                    // exit completed process
+        }
+    }
+}
@@ -0,0 +1,165 @@
+/***************************************************************************
+* File: blackjack_shuffle.h
+* Author: Milan Gulati
+* Procedures:
+* laneDraws         - swap positions of SHUFFLE_LANES consecutive games at once (AVX-512)
+* shuffleBatch      - deals the decks of SHUFFLE_LANES consecutive games
+* ringStart         - empties a deck ring for a run
+* ringDeal          - the deck of one game, refilling the ring in batches
+***************************************************************************/
+
+#ifndef BLACKJACK_SHUFFLE_H
+#define BLACKJACK_SHUFFLE_H
+
+/* Import Libraries */
+#include <string.h>
+#include "blackjack_deck.h"
+
+#define SHUFFLE_LANES   8                   // games shuffled side by side, one per vector lane
+#define SHUFFLE_RING    64                  // decks dealt ahead, a multiple of SHUFFLE_LANES
+
+/*
+* laneWords holds one splitmix64 state (or value) per game, laneBytes one
+* swap position per game; GCC maps the arithmetic onto whatever vector unit
+* the function is compiled for
+*/
+typedef unsigned long laneWords __attribute__((vector_size(SHUFFLE_LANES * 8)));
+typedef unsigned char laneBytes __attribute__((vector_size(SHUFFLE_LANES)));
+
+/*
+* deckRing holds the decks of SHUFFLE_RING consecutive games, dealt in one
+* go by shuffleBatch when the dealer reaches a game past the end; at 3 KB it
+* stays in L1 while the games consume it
+*/
+struct deckRing
+{
+    unsigned long seed;                     // seed of the run
+    long base;                              // game whose deck is decks[0]
+    long filled;                            // decks dealt from base, 0 when empty
+    char decks[SHUFFLE_RING][DECK_SIZE];
+};
+
+/***************************************************************************
+* void laneDraws(laneBytes draws[DECK_SIZE], unsigned long seed, long game)
+* Author: Milan Gulati
+* Description: The random half of shuffleDeck for games game to
+*              game + SHUFFLE_LANES - 1 together: lane l runs game + l's own
+*              splitmix64 stream, and draws[j] gets each lane's swap position
+*              for card j, boundedRand(r, j + 1). Same arithmetic, so the
+*              same positions as shuffleDeck, without a division anywhere.
+*              Compiled with AVX-512 enabled for this function only: only
+*              AVX-512DQ has a 64 bit vector multiply (vpmullq). Without it
+*              the compiler splits every multiply into 32 bit pieces and the
+*              vector code is slower than the scalar generator.
+*
+* Parameters:
+*   draws   O/P     laneBytes [DECK_SIZE]   Swap positions, draws[1] to draws[DECK_SIZE - 1]
+*   seed    I/P     unsigned long           Seed of the whole run
+*   game    I/P     long                    First game of the batch
+***************************************************************************/
+#if defined(__x86_64__)
+__attribute__((target("avx512f,avx512dq,avx512vl,avx512bw")))
+inline void laneDraws(laneBytes draws[DECK_SIZE], unsigned long seed, long game)
+{
+    laneWords state;
+    for(int l = 0; l < SHUFFLE_LANES; l++)
+        state[l] = gameState(seed, game + l);
+    for(int j = DECK_SIZE - 1; j > 0; j--)
+    {
+        laneWords z = (state += 0x9E3779B97F4A7C15UL);     // splitmix64, every lane at once
+        z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9UL;
+        z = (z ^ (z >> 27)) * 0x94D049BB133111EBUL;
+        z ^= z >> 31;
+        laneWords k = ((z >> 32) * (unsigned long) (j + 1)) >> 32;   // boundedRand
+        draws[j] = __builtin_convertvector(k, laneBytes);
+    }
+}
+#endif
+
+/***************************************************************************
+* void shuffleBatch(char decks[][DECK_SIZE], unsigned long seed, long game)
+* Author: Milan Gulati
+* Description: Deals decks[l] exactly as shuffleDeck(decks[l], seed,
+*              game + l) would, for l = 0 to SHUFFLE_LANES - 1. On a cpu
+*              with AVX-512 (checked once) the swap positions of all the
+*              decks come from laneDraws, and the swaps then step through
+*              the decks side by side, so each deck's swaps overlap with the
+*              others' instead of waiting on their own loads and stores.
+*              Elsewhere each deck is dealt by shuffleDeck, which is already
+*              the fastest way to run splitmix64 with scalar multiplies.
+*
+* Parameters:
+*   decks   O/P     char [][DECK_SIZE]  SHUFFLE_LANES decks
+*   seed    I/P     unsigned long       Seed of the whole run
+*   game    I/P     long                Game of decks[0]
+***************************************************************************/
+inline void shuffleBatch(char decks[][DECK_SIZE], unsigned long seed, long game)
+{
+#if defined(__x86_64__)
+    static const bool avx512 = __builtin_cpu_supports("avx512dq") && __builtin_cpu_supports("avx512vl")
+                               && __builtin_cpu_supports("avx512bw");
+    if(avx512)
+    {
+        laneBytes draws[DECK_SIZE];
+        laneDraws(draws, seed, game);
+        for(int l = 0; l < SHUFFLE_LANES; l++)
+            memcpy(decks[l], deckOrder, DECK_SIZE);
+        for(int j = DECK_SIZE - 1; j > 0; j--)
+            for(int l = 0; l < SHUFFLE_LANES; l++)
+            {
+                char *cards = decks[l];
+                int k = draws[j][l];
+                char temp = cards[j];       // swap card j with a card at or below it
+                cards[j] = cards[k];
+                cards[k] = temp;
+            }
+        return;
+    }
+#endif
+    for(int l = 0; l < SHUFFLE_LANES; l++)
+        shuffleDeck(decks[l], seed, game + l);
+}
+
+/***************************************************************************
+* void ringStart(deckRing &ring, unsigned long seed)
+* Author: Milan Gulati
+* Description: Empties the ring; the first ringDeal fills it.
+*
+* Parameters:
+*   ring    O/P     deckRing &      Ring to set up
+*   seed    I/P     unsigned long   Seed of the run
+***************************************************************************/
+inline void ringStart(deckRing &ring, unsigned long seed)
+{
+    ring.seed = seed;
+    ring.base = 0;
+    ring.filled = 0;
+}
+
+/***************************************************************************
+* const char *ringDeal(deckRing &ring, long game)
+* Author: Milan Gulati
+* Description: Returns the deck of game, the same cards shuffleDeck deals.
+*              When game is outside the ring, the next SHUFFLE_RING games
+*              from game on are dealt in batches of SHUFFLE_LANES. Games are
+*              normally asked for in order, but any game works, so a resumed
+*              run or a shard starting mid range needs nothing special.
+*
+* Parameters:
+*   ring        I/O     deckRing &      Ring of dealt decks
+*   game        I/P     long            Index of the game in the run
+*   ringDeal    O/P     const char *    DECK_SIZE cards, valid until the next ringDeal
+***************************************************************************/
+inline const char *ringDeal(deckRing &ring, long game)
+{
+    if(game < ring.base || game >= ring.base + ring.filled)
+    {
+        ring.base = game;
+        for(int b = 0; b < SHUFFLE_RING; b += SHUFFLE_LANES)
+            shuffleBatch(&ring.decks[b], ring.seed, game + b);
+        ring.filled = SHUFFLE_RING;
+    }
+    return ring.decks[game - ring.base];
+}
+
+#endif
@@ -0,0 +1,141 @@
+/***************************************************************************
+* File: blackjack_signals.h
+* Author: Milan Gulati
+* Procedures:
+* cleanupQueue      - registers a message queue to remove on a fatal signal
+* cleanupShm        - registers a shared memory segment to remove on a fatal signal
+* cleanupHandler    - removes every registered IPC object and exits
+* installCleanup    - installs cleanupHandler for the terminating signals
+* cleanupClear      - forgets every registered IPC object
+* followParent      - makes a worker process exit when its parent dies
+***************************************************************************/
+
+#ifndef BLACKJACK_SIGNALS_H
+#define BLACKJACK_SIGNALS_H
+
+/* Import Libraries */
+#include <sys/types.h>
+#include <sys/ipc.h>
+#include <sys/msg.h>
+#include <sys/shm.h>
+#include <sys/prctl.h>
+#include <signal.h>
+#include <unistd.h>
+
+#define CLEANUP_MAX 16                      // most IPC objects one process registers
+
+/*
+* SysV message queues and shared memory outlive the process that created
+* them, so a dealer killed before its msgctl(..., IPC_RMID) calls leaves
+* them behind; the ids are kept here for the signal handler to remove
+*/
+static volatile sig_atomic_t cleanupQueues = 0;        // number of queue ids
+static int cleanupQueueIds[CLEANUP_MAX];                // queue ids to remove
+static volatile sig_atomic_t cleanupShms = 0;          // number of segment ids
+static int cleanupShmIds[CLEANUP_MAX];                  // segment ids to remove
+
+/***************************************************************************
+* void cleanupQueue(int id)
+* Author: Milan Gulati
+* Description: Registers a message queue id for removal on a fatal signal.
+*
+* Parameters:
+*   id      I/P     int     Message queue id from msgget
+***************************************************************************/
+inline void cleanupQueue(int id)
+{
+    if(id != -1 && cleanupQueues < CLEANUP_MAX)
+    {
+        cleanupQueueIds[cleanupQueues] = id;
+        cleanupQueues = cleanupQueues + 1;
+    }
+}
+
+/***************************************************************************
+* void cleanupShm(int id)
+* Author: Milan Gulati
+* Description: Registers a shared memory segment id for removal on a fatal
+*              signal.
+*
+* Parameters:
+*   id      I/P     int     Segment id from shmget
+***************************************************************************/
+inline void cleanupShm(int id)
+{
+    if(id != -1 && cleanupShms < CLEANUP_MAX)
+    {
+        cleanupShmIds[cleanupShms] = id;
+        cleanupShms = cleanupShms + 1;
+    }
+}
+
+/***************************************************************************
+* void cleanupHandler(int sig)
+* Author: Milan Gulati
+* Description: Signal handler that removes every registered queue and
+*              segment, then exits with the conventional 128 + signal code.
+*              Only async-signal-safe calls are made. Removing the queues
+*              also wakes any player blocked in msgrcv with EIDRM.
+*
+* Parameters:
+*   sig     I/P     int     Signal number received
+***************************************************************************/
+inline void cleanupHandler(int sig)
+{
+    for(int i = 0; i < cleanupQueues; i++)
+        msgctl(cleanupQueueIds[i], IPC_RMID, NULL);
+    for(int i = 0; i < cleanupShms; i++)
+        shmctl(cleanupShmIds[i], IPC_RMID, NULL);
+    _exit(128 + sig);
+}
+
+/***************************************************************************
+* void installCleanup()
+* Author: Milan Gulati
+* Description: Installs cleanupHandler for SIGINT, SIGTERM, SIGHUP, SIGQUIT
+*              and SIGPIPE (a pipe dealer whose player died). Called by the
+*              dealer only, after fork(), so the players do not remove the
+*              dealer's objects.
+***************************************************************************/
+inline void installCleanup()
+{
+    struct sigaction sa;
+    sa.sa_handler = cleanupHandler;
+    sigemptyset(&sa.sa_mask);
+    sa.sa_flags = 0;
+
+    int sigs[] = {SIGINT, SIGTERM, SIGHUP, SIGQUIT, SIGPIPE};
+    for(int s: sigs)
+        sigaction(s, &sa, NULL);
+}
+
+/***************************************************************************
+* void cleanupClear()
+* Author: Milan Gulati
+* Description: Forgets every registered id once the dealer has removed the
+*              objects itself, so an agent playing many shards neither fills
+*              the table nor removes ids the kernel has since reused.
+***************************************************************************/
+inline void cleanupClear()
+{
+    cleanupQueues = 0;
+    cleanupShms = 0;
+}
+
+/***************************************************************************
+* void followParent(pid_t parent)
+* Author: Milan Gulati
+* Description: Asks the kernel to send SIGTERM to this process when its
+*              parent exits, so workers never outlive a killed dealer.
+*
+* Parameters:
+*   parent  I/P     pid_t   Pid of the parent, read before fork()
+***************************************************************************/
+inline void followParent(pid_t parent)
+{
+    prctl(PR_SET_PDEATHSIG, SIGTERM);
+    if(getppid() != parent)                 // parent already died before prctl
+        _exit(1);
+}
+
+#endif
@@ -0,0 +1,274 @@
+/***************************************************************************
+* File: blackjack_stats.h
+* Author: Milan Gulati
+* Procedures:
+* statsKey      - computes the shared memory key for a variant's stats page
+* statsCreate   - creates and attaches the stats page (dealer side)
+* statsPublish  - publishes game counters to the stats page
+* statsQueues   - publishes IPC queue depths to the stats page
+* statsFinish   - marks the run finished and removes the stats page
+* statsSnapshot - takes a consistent copy of the stats page (bjstat side)
+***************************************************************************/
+
+#ifndef BLACKJACK_STATS_H
+#define BLACKJACK_STATS_H
+
+/* Import Libraries */
+#include <sys/types.h>
+#include <sys/ipc.h>
+#include <sys/shm.h>
+#include <unistd.h>
+#include <signal.h>
+#include <errno.h>
+#include <string.h>
+#include <time.h>
+#include <atomic>
+
+#define STATS_MAGIC     0x424a535441545331L     // "BJSTATS1"
+#define STATS_SEATS     2                       // player seats at the table
+#define STATS_QUEUES    6                       // most IPC channels any variant reports
+#define STATS_PERIOD    4096                    // games between queue depth samples
+
+/*
+* statsPage is the live metrics page shared between the dealer and bjstat
+* the dealer is the only writer; readers never block the dealer
+* seq is a sequence lock: odd while the dealer is mid-update, even otherwise
+* a reader retries its copy if seq was odd or changed while it copied
+*/
+struct statsPage
+{
+    long magic;                             // STATS_MAGIC once initialised
+    std::atomic<unsigned long> seq;         // sequence lock counter
+    int shmid;                              // id of this segment (for removal)
+    pid_t pid;                              // pid of the dealer process
+    char variant[16];                       // "mq", "pipes" or "shm"
+    double startTime;                       // CLOCK_MONOTONIC seconds at start
+    long gamesFirst;                        // first game played (non zero after resume)
+    long gamesTotal;                        // games requested for this run
+    long gamesDone;                         // games completed so far
+    long seatWins[STATS_SEATS];             // wins per player seat
+    long dealerWins;                        // dealer wins
+    int nqueues;                            // number of entries used in queueDepth
+    char queueName[STATS_QUEUES][8];        // short label for each channel
+    long queueDepth[STATS_QUEUES];          // bytes waiting in each channel
+    double queueTime;                       // CLOCK_MONOTONIC seconds of last sample
+    int finished;                           // set once the dealer is done
+};
+
+/***************************************************************************
+* double monotonicNow()
+* Author: Milan Gulati
+* Description: Returns CLOCK_MONOTONIC as seconds. The clock is system wide,
+*              so the dealer and bjstat can compare each other's readings.
+*
+* Parameters:
+*   monotonicNow    O/P     double      Current monotonic time in seconds
+***************************************************************************/
+inline double monotonicNow()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/***************************************************************************
+* key_t statsKey(char variant)
+* Author: Milan Gulati
+* Description: Computes the SysV key of the stats page. The key is made with
+*              ftok on the current directory, so bjstat must be started from
+*              the same directory as the simulation. Each variant uses its
+*              own proj_id so both can be monitored at the same time.
+*
+* Parameters:
+*   variant     I/P     char    'M' for message queues, 'P' for pipes, 'H' for the shared deck
+*   statsKey    O/P     key_t   Key for shmget, -1 on failure
+***************************************************************************/
+inline key_t statsKey(char variant)
+{
+    return ftok(".", variant);
+}
+
+/***************************************************************************
+* statsPage *statsCreate(char variant, const char *name, long first, long games, pid_t &owner)
+* Author: Milan Gulati
+* Description: Creates the stats page for this variant, attaches it and
+*              resets every counter. The page is created exclusively and
+*              only the dealer's user may write it. A page left behind by a
+*              dealer that no longer runs is removed and replaced; a page
+*              whose creator is still running belongs to another run from
+*              the same directory and is never shared.
+*
+* Parameters:
+*   variant         I/P     char            Variant id passed to statsKey
+*   name            I/P     const char *    Variant name shown by bjstat
+*   first           I/P     long            First game this process plays
+*   games           I/P     long            Games requested for this run
+*   owner           O/P     pid_t &         Pid of the run holding the page if it is in use, 0 otherwise
+*   statsCreate     O/P     statsPage *     Attached page, NULL on failure
+***************************************************************************/
+inline statsPage *statsCreate(char variant, const char *name, long first, long games, pid_t &owner)
+{
+    owner = 0;
+    key_t key = statsKey(variant);
+    if(key == -1)
+        return NULL;
+
+    int shmid = shmget(key, sizeof(statsPage), 0644 | IPC_CREAT | IPC_EXCL);
+    if(shmid == -1 && errno == EEXIST)
+    {
+        struct shmid_ds ds;
+        int old = shmget(key, 0, 0);
+        if(old == -1 || shmctl(old, IPC_STAT, &ds) == -1)
+            return NULL;
+        if(kill(ds.shm_cpid, 0) == 0 || errno == EPERM)
+        {
+            owner = ds.shm_cpid;            // another live run publishes here
+            return NULL;
+        }
+        if(shmctl(old, IPC_RMID, NULL) == -1)   // stale page of a killed run
+            return NULL;
+        shmid = shmget(key, sizeof(statsPage), 0644 | IPC_CREAT | IPC_EXCL);
+    }
+    if(shmid == -1)
+        return NULL;
+
+    void *addr = shmat(shmid, NULL, 0);
+    if(addr == (void *) -1)
+    {
+        shmctl(shmid, IPC_RMID, NULL);
+        return NULL;
+    }
+
+    statsPage *page = (statsPage *) addr;
+    memset((void *) page, 0, sizeof(statsPage));     // fresh counters (seq = 0)
+    page->shmid = shmid;
+    page->pid = getpid();
+    strncpy(page->variant, name, sizeof(page->variant) - 1);
+    page->startTime = monotonicNow();
+    page->gamesFirst = first;
+    page->gamesDone = first;
+    page->gamesTotal = games;
+    page->magic = STATS_MAGIC;              // readers ignore the page until this is set
+    return page;
+}
+
+/***************************************************************************
+* void statsPublish(statsPage *page, long done, const long seatWins[], long dealerWins)
+* Author: Milan Gulati
+* Description: Copies the dealer's counters to the stats page. Only plain
+*              stores and two atomic stores, so it is cheap enough to call
+*              once per game.
+*
+* Parameters:
+*   page        I/P     statsPage *     Attached stats page (may be NULL)
+*   done        I/P     long            Games completed
+*   seatWins    I/P     const long []   Wins for each of the STATS_SEATS seats
+*   dealerWins  I/P     long            Dealer wins
+***************************************************************************/
+inline void statsPublish(statsPage *page, long done, const long seatWins[], long dealerWins)
+{
+    if(page == NULL)
+        return;
+
+    unsigned long s = page->seq.load(std::memory_order_relaxed);
+    page->seq.store(s + 1, std::memory_order_relaxed);     // begin update (odd)
+    std::atomic_thread_fence(std::memory_order_release);
+
+    page->gamesDone = done;
+    for(int i = 0; i < STATS_SEATS; i++)
+        page->seatWins[i] = seatWins[i];
+    page->dealerWins = dealerWins;
+
+    page->seq.store(s + 2, std::memory_order_release);     // end update (even)
+}
+
+/***************************************************************************
+* void statsQueues(statsPage *page, int n, const char *names[], const long depth[])
+* Author: Milan Gulati
+* Description: Publishes the number of bytes waiting in each IPC channel.
+*              Sampling the channels needs system calls, so the dealer only
+*              calls this every STATS_PERIOD games.
+*
+* Parameters:
+*   page    I/P     statsPage *         Attached stats page (may be NULL)
+*   n       I/P     int                 Number of channels (<= STATS_QUEUES)
+*   names   I/P     const char *[]      Label for each channel
+*   depth   I/P     const long []       Bytes waiting in each channel
+***************************************************************************/
+inline void statsQueues(statsPage *page, int n, const char *names[], const long depth[])
+{
+    if(page == NULL)
+        return;
+    if(n > STATS_QUEUES)
+        n = STATS_QUEUES;
+
+    unsigned long s = page->seq.load(std::memory_order_relaxed);
+    page->seq.store(s + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+
+    page->nqueues = n;
+    for(int i = 0; i < n; i++)
+    {
+        strncpy(page->queueName[i], names[i], sizeof(page->queueName[i]) - 1);
+        page->queueDepth[i] = depth[i];
+    }
+    page->queueTime = monotonicNow();
+
+    page->seq.store(s + 2, std::memory_order_release);
+}
+
+/***************************************************************************
+* void statsFinish(statsPage *page)
+* Author: Milan Gulati
+* Description: Marks the run finished, detaches and removes the stats page.
+*              The segment stays readable until the last bjstat detaches.
+*
+* Parameters:
+*   page    I/P     statsPage *     Attached stats page (may be NULL)
+***************************************************************************/
+inline void statsFinish(statsPage *page)
+{
+    if(page == NULL)
+        return;
+
+    int shmid = page->shmid;
+    unsigned long s = page->seq.load(std::memory_order_relaxed);
+    page->seq.store(s + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    page->finished = 1;
+    page->seq.store(s + 2, std::memory_order_release);
+
+    shmdt(page);                            // detach from dealer
+    shmctl(shmid, IPC_RMID, NULL);          // destroyed once bjstat detaches too
+}
+
+/***************************************************************************
+* bool statsSnapshot(const statsPage *page, statsPage &copy)
+* Author: Milan Gulati
+* Description: Copies the stats page without stopping the dealer. Retries
+*              while the dealer is in the middle of an update.
+*
+* Parameters:
+*   page            I/P     const statsPage *   Attached stats page
+*   copy            O/P     statsPage &         Consistent copy of the page
+*   statsSnapshot   O/P     bool                False if the page is not initialised
+***************************************************************************/
+inline bool statsSnapshot(const statsPage *page, statsPage &copy)
+{
+    for(int tries = 0; tries < 1000; tries++)
+    {
+        unsigned long s1 = page->seq.load(std::memory_order_acquire);
+        if(s1 & 1)                          // dealer is writing, try again
+            continue;
+
+        memcpy((void *) &copy, (const void *) page, sizeof(statsPage));
+        std::atomic_thread_fence(std::memory_order_acquire);
+
+        unsigned long s2 = page->seq.load(std::memory_order_relaxed);
+        if(s1 == s2)                        // nothing changed during the copy
+            return copy.magic == STATS_MAGIC;
+    }
+    return false;
+}
+
+#endif
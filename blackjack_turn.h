@@ -0,0 +1,135 @@
+/***************************************************************************
+* File: blackjack_turn.h
+* Author: Milan Gulati
+* Procedures:
+* tableCreate   - maps the shared deck and turn counter (before fork)
+* turnWait      - waits until it is a given actor's turn
+* turnPass      - hands the turn to the next actor
+***************************************************************************/
+
+#ifndef BLACKJACK_TURN_H
+#define BLACKJACK_TURN_H
+
+/* Import Libraries */
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <sys/wait.h>
+#include <linux/futex.h>
+#include <errno.h>
+#include <limits.h>
+#include <time.h>
+#include <unistd.h>
+#include <atomic>
+#include "blackjack_deck.h"
+#include "blackjack_game.h"
+
+#define TURN_DEALER     0                   // dealer deals or settles the game
+#define TURN_P1         1                   // player one draws
+#define TURN_P2         2                   // player two draws
+#define TURN_SPIN       2000                // polls before sleeping in the kernel
+#define TURN_CHECK_NS   100000000L          // how often a sleeper checks its child (100 ms)
+
+/*
+* sharedTable is the whole game state shared by the dealer and both players
+* only the actor whose turn it is touches spot, cards and seat; passing the
+* turn is a release store and waiting for it an acquire load, so whatever the
+* previous actor wrote is visible to the next without further locking
+* turn doubles as the futex word the other actors sleep on
+*/
+struct sharedTable
+{
+    std::atomic<int> turn;                  // TURN_DEALER, TURN_P1 or TURN_P2
+    std::atomic<int> waiters;               // actors asleep in FUTEX_WAIT
+    int spins;                              // polls before sleeping, 0 on one cpu
+    int spot;                               // next card to draw from cards
+    seatResult seat[2];                     // hands each player played, for the dealer
+    char cards[DECK_SIZE];                  // deck of the game being played
+};
+
+/***************************************************************************
+* sharedTable *tableCreate()
+* Author: Milan Gulati
+* Description: Maps a zeroed sharedTable shared with every process forked
+*              afterwards. The turn starts with the dealer. Spinning before
+*              sleeping only pays when the actors run on different cpus, so
+*              it is turned off on a single cpu machine.
+*
+* Parameters:
+*   tableCreate O/P     sharedTable *   Shared table, NULL on failure
+***************************************************************************/
+inline sharedTable *tableCreate()
+{
+    void *mem = mmap(NULL, sizeof(sharedTable), PROT_READ | PROT_WRITE,
+                     MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+    if(mem == MAP_FAILED)
+        return NULL;
+    sharedTable *table = (sharedTable *) mem;   // anonymous pages are already zero
+    table->spins = sysconf(_SC_NPROCESSORS_ONLN) > 1 ? TURN_SPIN : 0;
+    return table;
+}
+
+/***************************************************************************
+* bool turnWait(sharedTable *table, int want, pid_t child)
+* Author: Milan Gulati
+* Description: Returns once table->turn is want. Polls briefly, then sleeps
+*              on the turn word with FUTEX_WAIT (the shared, not private,
+*              futex, since the actors are separate processes). A sleeper
+*              wakes every TURN_CHECK_NS to check that its child is still
+*              running, so a dead player cannot hang the table. The check
+*              leaves an exited child unreaped for the caller to collect.
+*
+* Parameters:
+*   table       I/O     sharedTable *   Shared table
+*   want        I/P     int             Turn to wait for
+*   child       I/P     pid_t           Child process to watch, 0 for none
+*   turnWait    O/P     bool            False if the child exited first
+***************************************************************************/
+inline bool turnWait(sharedTable *table, int want, pid_t child)
+{
+    for(int i = 0; i < table->spins; i++)
+    {
+        if(table->turn.load(std::memory_order_acquire) == want)
+            return true;
+#if defined(__x86_64__) || defined(__i386__)
+        __builtin_ia32_pause();             // be kind to a hyperthread sibling
+#endif
+    }
+
+    struct timespec check = {0, TURN_CHECK_NS};
+    while(true)
+    {
+        int now = table->turn.load();
+        if(now == want)
+            return true;
+        // announce the sleep before re-checking in the kernel: turnPass
+        // either sees waiters > 0 or the kernel sees the new turn
+        table->waiters.fetch_add(1);
+        long r = syscall(SYS_futex, (int *) &table->turn, FUTEX_WAIT, now, &check, NULL, 0);
+        table->waiters.fetch_sub(1);
+        siginfo_t info;
+        info.si_pid = 0;                    // stays 0 while the child runs
+        if(r == -1 && errno == ETIMEDOUT && child > 0
+           && (waitid(P_PID, child, &info, WEXITED | WNOHANG | WNOWAIT) == -1 || info.si_pid != 0))
+            return false;
+    }
+}
+
+/***************************************************************************
+* void turnPass(sharedTable *table, int next)
+* Author: Milan Gulati
+* Description: Gives the turn to next and wakes any sleeping actor. The
+*              wake system call is skipped when nobody sleeps, so actors on
+*              separate cpus hand over the turn without entering the kernel.
+*
+* Parameters:
+*   table   I/O     sharedTable *   Shared table
+*   next    I/P     int             Actor whose turn it now is
+***************************************************************************/
+inline void turnPass(sharedTable *table, int next)
+{
+    table->turn.store(next);
+    if(table->waiters.load() > 0)           // actors wait for different turns, wake all
+        syscall(SYS_futex, (int *) &table->turn, FUTEX_WAKE, INT_MAX, NULL, NULL, 0);
+}
+
+#endif
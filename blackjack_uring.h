@@ -0,0 +1,383 @@
+/***************************************************************************
+* File: blackjack_uring.h
+* Author: Milan Gulati
+* Procedures:
+* uringSetup    - creates an io_uring and maps its rings
+* uringProbe    - checks whether this kernel lets us use io_uring (and SQPOLL)
+* ioOpen        - prepares a process's pipe I/O, on io_uring or plain calls
+* ioClose       - releases a process's pipe I/O
+* ioQueue       - queues one read or write (performs it at once without io_uring)
+* ioRead        - queues a read of len bytes from a pipe
+* ioWrite       - queues a write of len bytes to a pipe
+* ioFlush       - submits everything queued and waits for all of it
+***************************************************************************/
+
+#ifndef BLACKJACK_URING_H
+#define BLACKJACK_URING_H
+
+/* Import Libraries */
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <errno.h>
+#include <string.h>
+#include <unistd.h>
+
+#define URING_OFF       0                   // plain read() and write()
+#define URING_ON        1                   // io_uring, one io_uring_enter per batch
+#define URING_SQPOLL    2                   // io_uring with a kernel submission thread
+#define URING_ENTRIES   8                   // most operations one batch queues
+#define URING_SPIN      4000                // completion polls before sleeping (SQPOLL)
+
+// one queued read or write, kept to finish short transfers
+struct ioOp
+{
+    int fd;                                 // pipe end
+    char *buf;                              // bytes to write or buffer to read into
+    unsigned len;                           // bytes requested
+    bool write;                             // write if true, read otherwise
+};
+
+/*
+* pipeIO is one process's view of its pipe ends
+* without a ring every ioRead/ioWrite is the plain blocking call it replaces;
+* with a ring they only fill submission entries, and ioFlush hands the whole
+* batch to the kernel with a single io_uring_enter (none at all with SQPOLL
+* while the kernel thread is awake) and waits for every completion
+* rings are per process: each actor opens its own after fork()
+*/
+struct pipeIO
+{
+    int mode;                               // URING_OFF, URING_ON or URING_SQPOLL
+    int ringFd;                             // io_uring fd, -1 without a ring
+    void *sqRing, *cqRing;                  // mapped ring headers
+    size_t sqSize, cqSize;                  // mapped sizes
+    struct io_uring_sqe *sqes;              // submission entries
+    unsigned *sqTail, *sqMask, *sqArray, *sqFlags;
+    unsigned *cqHead, *cqTail, *cqMask;
+    struct io_uring_cqe *cqes;              // completion entries
+    ioOp ops[URING_ENTRIES];                // operations in the current batch
+    unsigned queued;                        // operations in the current batch
+    bool failed;                            // an operation failed or hit end of file
+};
+
+/***************************************************************************
+* bool uringSetup(pipeIO &io, bool sqpoll)
+* Author: Milan Gulati
+* Description: Creates an io_uring with io_uring_setup and maps the
+*              submission ring, completion ring and submission entries. No
+*              liburing: the three mappings are all a ring needs.
+*
+* Parameters:
+*   io          O/P     pipeIO &    Filled with the ring on success
+*   sqpoll      I/P     bool        Ask for a kernel submission thread
+*   uringSetup  O/P     bool        False if the kernel refused
+***************************************************************************/
+inline bool uringSetup(pipeIO &io, bool sqpoll)
+{
+    struct io_uring_params p;
+    memset(&p, 0, sizeof(p));
+    if(sqpoll)
+    {
+        p.flags = IORING_SETUP_SQPOLL;
+        p.sq_thread_idle = 1000;            // ms before the thread sleeps
+    }
+    int fd = syscall(__NR_io_uring_setup, URING_ENTRIES, &p);
+    if(fd < 0)
+        return false;
+
+    io.sqSize = p.sq_off.array + p.sq_entries * sizeof(unsigned);
+    io.cqSize = p.cq_off.cqes + p.cq_entries * sizeof(struct io_uring_cqe);
+    if(p.features & IORING_FEAT_SINGLE_MMAP)    // both rings in one mapping
+        io.sqSize = io.cqSize = io.sqSize > io.cqSize ? io.sqSize : io.cqSize;
+
+    io.sqRing = mmap(NULL, io.sqSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQ_RING);
+    if(io.sqRing == MAP_FAILED)
+    {
+        close(fd);
+        return false;
+    }
+    io.cqRing = io.sqRing;
+    if(!(p.features & IORING_FEAT_SINGLE_MMAP))
+        io.cqRing = mmap(NULL, io.cqSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_CQ_RING);
+    size_t sqesSize = p.sq_entries * sizeof(struct io_uring_sqe);
+    io.sqes = (struct io_uring_sqe *) mmap(NULL, sqesSize, PROT_READ | PROT_WRITE,
+                                           MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQES);
+    if(io.cqRing == MAP_FAILED || io.sqes == MAP_FAILED)
+    {
+        if(io.sqes != MAP_FAILED)           // undo whichever mappings were made
+            munmap(io.sqes, sqesSize);
+        if(io.cqRing != MAP_FAILED && io.cqRing != io.sqRing)
+            munmap(io.cqRing, io.cqSize);
+        munmap(io.sqRing, io.sqSize);
+        close(fd);
+        return false;
+    }
+
+    char *sq = (char *) io.sqRing;
+    char *cq = (char *) io.cqRing;
+    io.sqTail = (unsigned *) (sq + p.sq_off.tail);
+    io.sqMask = (unsigned *) (sq + p.sq_off.ring_mask);
+    io.sqArray = (unsigned *) (sq + p.sq_off.array);
+    io.sqFlags = (unsigned *) (sq + p.sq_off.flags);
+    io.cqHead = (unsigned *) (cq + p.cq_off.head);
+    io.cqTail = (unsigned *) (cq + p.cq_off.tail);
+    io.cqMask = (unsigned *) (cq + p.cq_off.ring_mask);
+    io.cqes = (struct io_uring_cqe *) (cq + p.cq_off.cqes);
+    io.ringFd = fd;
+    return true;
+}
+
+/***************************************************************************
+* void ioClose(pipeIO &io)
+* Author: Milan Gulati
+* Description: Unmaps and closes the ring, if there is one.
+*
+* Parameters:
+*   io      I/O     pipeIO &    Pipe I/O to release
+***************************************************************************/
+inline void ioClose(pipeIO &io)
+{
+    if(io.ringFd == -1)
+        return;
+    munmap(io.sqes, URING_ENTRIES * sizeof(struct io_uring_sqe));
+    if(io.cqRing != io.sqRing)
+        munmap(io.cqRing, io.cqSize);
+    munmap(io.sqRing, io.sqSize);
+    close(io.ringFd);
+    io.ringFd = -1;
+}
+
+/***************************************************************************
+* int uringProbe(int mode)
+* Author: Milan Gulati
+* Description: Finds the best mode this kernel allows, up to the one asked
+*              for: SQPOLL may need privileges, and io_uring itself may be
+*              missing, disabled by sysctl or blocked by a seccomp filter.
+*              SQPOLL is also dropped on a single cpu: each process gets a
+*              kernel thread that polls its ring, and with no spare core the
+*              pollers only take turns with the players they serve.
+*
+* Parameters:
+*   mode        I/P     int     Mode requested
+*   uringProbe  O/P     int     Mode that works, URING_OFF if io_uring does not
+***************************************************************************/
+inline int uringProbe(int mode)
+{
+    if(mode == URING_SQPOLL && sysconf(_SC_NPROCESSORS_ONLN) < 2)
+        mode = URING_ON;
+    for(; mode != URING_OFF; mode--)
+    {
+        pipeIO io;
+        memset(&io, 0, sizeof(io));
+        io.ringFd = -1;
+        if(uringSetup(io, mode == URING_SQPOLL))
+        {
+            ioClose(io);
+            return mode;
+        }
+    }
+    return URING_OFF;
+}
+
+/***************************************************************************
+* void ioOpen(pipeIO &io, int mode)
+* Author: Milan Gulati
+* Description: Prepares pipe I/O for the calling process. Falls back to
+*              plain calls if the ring cannot be created.
+*
+* Parameters:
+*   io      O/P     pipeIO &    Pipe I/O to prepare
+*   mode    I/P     int         URING_OFF, URING_ON or URING_SQPOLL
+***************************************************************************/
+inline void ioOpen(pipeIO &io, int mode)
+{
+    memset(&io, 0, sizeof(io));
+    io.ringFd = -1;
+    io.mode = URING_OFF;
+    if(mode != URING_OFF && uringSetup(io, mode == URING_SQPOLL))
+        io.mode = mode;
+}
+
+/***************************************************************************
+* bool ioFinish(ioOp &op, unsigned done)
+* Author: Milan Gulati
+* Description: Completes a transfer the ring left short with plain calls.
+*              Pipes move small writes atomically, so this is rare.
+*
+* Parameters:
+*   op          I/P     ioOp &      Operation that moved only done bytes
+*   done        I/P     unsigned    Bytes already moved
+*   ioFinish    O/P     bool        False on error or end of file
+***************************************************************************/
+inline bool ioFinish(ioOp &op, unsigned done)
+{
+    while(done < op.len)
+    {
+        ssize_t n = op.write ? write(op.fd, op.buf + done, op.len - done)
+                             : read(op.fd, op.buf + done, op.len - done);
+        if(n <= 0)
+            return false;
+        done += n;
+    }
+    return true;
+}
+
+/***************************************************************************
+* void ioQueue(pipeIO &io, int fd, void *buf, unsigned len, bool write)
+* Author: Milan Gulati
+* Description: Adds one read or write to the current batch. Without a ring
+*              the transfer is done immediately. Operations in one batch
+*              may run in any order, so a batch must not hold two
+*              operations on the same pipe end, and it holds at most
+*              URING_ENTRIES of them; one more makes ioFlush fail.
+*
+* Parameters:
+*   io      I/O     pipeIO &    Pipe I/O
+*   fd      I/P     int         Pipe end
+*   buf     I/O     void *      Bytes to write or buffer to read into
+*   len     I/P     unsigned    Number of bytes
+*   write   I/P     bool        Write if true, read otherwise
+***************************************************************************/
+inline void ioQueue(pipeIO &io, int fd, void *buf, unsigned len, bool write)
+{
+    ioOp op = {fd, (char *) buf, len, write};
+    if(io.mode == URING_OFF)
+    {
+        if(!ioFinish(op, 0))
+            io.failed = true;
+        return;
+    }
+
+    if(io.queued >= URING_ENTRIES)          // the batch is full: fail the flush rather than overrun the ring
+    {
+        io.failed = true;
+        return;
+    }
+    unsigned tail = *io.sqTail;             // only this process moves the tail
+    unsigned index = tail & *io.sqMask;
+    struct io_uring_sqe *sqe = &io.sqes[index];
+    memset(sqe, 0, sizeof(*sqe));
+    sqe->opcode = write ? IORING_OP_WRITE : IORING_OP_READ;
+    sqe->fd = fd;
+    sqe->addr = (unsigned long) buf;
+    sqe->len = len;
+    sqe->off = (__u64) -1;                  // pipes have no offset
+    sqe->user_data = io.queued;
+    io.sqArray[index] = index;
+    io.ops[io.queued++] = op;
+    __atomic_store_n(io.sqTail, tail + 1, __ATOMIC_RELEASE);
+}
+
+/***************************************************************************
+* void ioRead(pipeIO &io, int fd, void *buf, unsigned len)
+* Author: Milan Gulati
+* Description: Queues a read of exactly len bytes. buf is only filled once
+*              ioFlush returns.
+*
+* Parameters:
+*   io      I/O     pipeIO &    Pipe I/O
+*   fd      I/P     int         Read end of a pipe
+*   buf     O/P     void *      Buffer to read into
+*   len     I/P     unsigned    Number of bytes
+***************************************************************************/
+inline void ioRead(pipeIO &io, int fd, void *buf, unsigned len)
+{
+    ioQueue(io, fd, buf, len, false);
+}
+
+/***************************************************************************
+* void ioWrite(pipeIO &io, int fd, const void *buf, unsigned len)
+* Author: Milan Gulati
+* Description: Queues a write of len bytes. buf must stay unchanged until
+*              ioFlush returns.
+*
+* Parameters:
+*   io      I/O     pipeIO &        Pipe I/O
+*   fd      I/P     int             Write end of a pipe
+*   buf     I/P     const void *    Bytes to write
+*   len     I/P     unsigned        Number of bytes
+***************************************************************************/
+inline void ioWrite(pipeIO &io, int fd, const void *buf, unsigned len)
+{
+    ioQueue(io, fd, (void *) buf, len, true);
+}
+
+/***************************************************************************
+* bool ioFlush(pipeIO &io)
+* Author: Milan Gulati
+* Description: Submits the batch and waits until every operation in it has
+*              completed. Without SQPOLL that is one io_uring_enter which
+*              both submits and waits; with SQPOLL the kernel thread picks
+*              the entries up by itself and completions are polled for a
+*              while before sleeping in io_uring_enter. An interrupted or
+*              busy io_uring_enter (EINTR, EAGAIN, EBUSY) is retried after
+*              reaping what has completed; any other error is fatal to the
+*              batch: the ring is closed, so no stale completion can be
+*              reaped later, and false is returned like a dead peer.
+*
+* Parameters:
+*   io          I/O     pipeIO &    Pipe I/O
+*   ioFlush     O/P     bool        False if any operation failed since the last flush
+***************************************************************************/
+inline bool ioFlush(pipeIO &io)
+{
+    unsigned want = io.queued;
+    io.queued = 0;
+    if(io.mode == URING_OFF || want == 0)
+    {
+        bool ok = !io.failed;
+        io.failed = false;
+        return ok;
+    }
+
+    unsigned submit = io.mode == URING_SQPOLL ? 0 : want;   // with SQPOLL the kernel thread submits
+
+    unsigned reaped = 0;
+    int spins = io.mode == URING_SQPOLL ? URING_SPIN : 0;
+    while(reaped < want)
+    {
+        unsigned head = *io.cqHead;
+        unsigned tail = __atomic_load_n(io.cqTail, __ATOMIC_ACQUIRE);
+        if(head == tail)                    // nothing completed yet
+        {
+            if(spins > 0)
+            {
+                spins--;
+                continue;
+            }
+            unsigned flags = IORING_ENTER_GETEVENTS;
+            // the tail store must be seen before the flag is read, or an idle
+            // thread could miss both the new entries and the wakeup
+            __atomic_thread_fence(__ATOMIC_SEQ_CST);
+            if(io.mode == URING_SQPOLL && (*io.sqFlags & IORING_SQ_NEED_WAKEUP))
+                flags |= IORING_ENTER_SQ_WAKEUP;
+            int r = syscall(__NR_io_uring_enter, io.ringFd, submit, want - reaped, flags, NULL, 0);
+            if(r < 0 && errno != EINTR && errno != EAGAIN && errno != EBUSY)
+            {
+                // entries may still be queued or in flight and cannot be
+                // replayed safely, so the batch is lost; drop the ring too
+                ioClose(io);
+                io.mode = URING_OFF;
+                io.failed = false;
+                return false;
+            }
+            if(r > 0)
+                submit -= r < (int) submit ? r : submit;
+            continue;
+        }
+        for(; head != tail; head++, reaped++)
+        {
+            struct io_uring_cqe *cqe = &io.cqes[head & *io.cqMask];
+            ioOp &op = io.ops[cqe->user_data];
+            if(cqe->res <= 0 || !ioFinish(op, cqe->res))
+                io.failed = true;
+        }
+        __atomic_store_n(io.cqHead, head, __ATOMIC_RELEASE);
+    }
+    bool ok = !io.failed;
+    io.failed = false;
+    return ok;
+}
+
+#endif